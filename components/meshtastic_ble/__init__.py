@@ -6,9 +6,11 @@ pipeline.  This file is the bridge between meshtastic_gw.yaml and the C++
 implementation in meshtastic_ble.h / meshtastic_ble.cpp.
 """
 
+import re
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+from esphome.const import CONF_ID, CONF_PORT
 
 # ── Dependencies declared here are checked at compile time ────────────────────
 # esp-idf framework is required; BLE APIs come from NimBLE via esp-idf.
@@ -25,7 +27,214 @@ MeshtasticBLEComponent = meshtastic_ble_ns.class_(
 CONF_NODE_NAME = "node_name"
 CONF_NODE_MAC = "node_mac"
 CONF_TOPIC_PREFIX = "topic_prefix"
+CONF_TOPIC_TEMPLATE = "topic_template"
 CONF_RECONNECT_INTERVAL = "reconnect_interval"
+CONF_DISCOVERY = "discovery"
+CONF_DISCOVERY_PREFIX = "discovery_prefix"
+CONF_DISCOVERY_INTERVAL = "discovery_interval"
+CONF_TELEMETRY_WINDOW = "telemetry_window"
+CONF_TELEMETRY_PASSTHROUGH = "telemetry_passthrough"
+CONF_STATE_FLUSH_DEADLINE = "state_flush_deadline"
+
+# Telemetry metric name → bit position.  Must match the TelemetryMetric enum in
+# meshtastic_ble.h.
+TELEMETRY_METRICS = {
+    "battery_level": 0,
+    "voltage": 1,
+    "temperature": 2,
+    "humidity": 3,
+}
+
+CONF_RATE_LIMIT = "rate_limit"
+CONF_INTERVAL = "interval"
+CONF_BURST = "burst"
+CONF_PORTS = "ports"
+
+CONF_TOPOLOGY = "topology"
+CONF_EDGE_TTL = "edge_ttl"
+
+TOPOLOGY_SCHEMA = cv.Schema(
+    {
+        # How often changed / removed edges are published.
+        cv.Optional(CONF_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+        # Edges not re-observed within this period are removed.
+        cv.Optional(CONF_EDGE_TTL, default="3h"): cv.positive_time_period_milliseconds,
+    }
+)
+
+CONF_LOG_RECORD = "log_record"
+CONF_LEVEL = "level"
+CONF_BATCH_SIZE = "batch_size"
+CONF_FLUSH_INTERVAL = "flush_interval"
+
+# meshtastic_LogRecord_Level values.
+LOG_LEVELS = {
+    "CRITICAL": 50,
+    "ERROR": 40,
+    "WARNING": 30,
+    "INFO": 20,
+    "DEBUG": 10,
+    "TRACE": 5,
+}
+
+LOG_RECORD_SCHEMA = cv.Schema(
+    {
+        # Records below this level are dropped on the gateway.
+        cv.Optional(CONF_LEVEL, default="WARNING"): cv.one_of(*LOG_LEVELS, upper=True),
+        # Publish once this many records are queued...
+        cv.Optional(CONF_BATCH_SIZE, default=16): cv.int_range(min=1, max=32),
+        # ...or the oldest queued record has waited this long.
+        cv.Optional(
+            CONF_FLUSH_INTERVAL, default="5s"
+        ): cv.positive_time_period_milliseconds,
+    }
+)
+
+CONF_CLUSTER = "cluster"
+CONF_TOPIC = "topic"
+CONF_GATEWAY_ID = "gateway_id"
+CONF_TIE_BREAK = "tie_break"
+CONF_DIGEST_INTERVAL = "digest_interval"
+CONF_HOLD_TIME = "hold_time"
+
+CLUSTER_SCHEMA = cv.Schema(
+    {
+        # Shared by every gateway in the cluster; defaults to <topic_prefix>/cluster.
+        cv.Optional(CONF_TOPIC): cv.publish_topic,
+        # Unique per gateway; defaults to a hash of the WiFi MAC.
+        cv.Optional(CONF_GATEWAY_ID): cv.All(cv.hex_uint32_t, cv.Range(min=1)),
+        # Agree on one owner per packet instead of first-digest-wins.
+        cv.Optional(CONF_TIE_BREAK, default=True): cv.boolean,
+        cv.Optional(
+            CONF_DIGEST_INTERVAL, default="1s"
+        ): cv.positive_time_period_milliseconds,
+        # How long a non-owner waits for the owner's digest (per rank).
+        cv.Optional(CONF_HOLD_TIME, default="1500ms"): cv.positive_time_period_milliseconds,
+    }
+)
+
+CONF_DIAGNOSTICS = "diagnostics"
+CONF_MIN_STACK_FREE = "min_stack_free"
+CONF_MIN_FREE_HEAP = "min_free_heap"
+CONF_MIN_LARGEST_BLOCK = "min_largest_block"
+CONF_MAX_FRAGMENTATION = "max_fragmentation"
+
+DIAGNOSTICS_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+        # Alert thresholds; a breach is listed in the report's "alerts" array.
+        cv.Optional(CONF_MIN_STACK_FREE, default=512): cv.int_range(min=0, max=65535),
+        cv.Optional(CONF_MIN_FREE_HEAP, default=20000): cv.int_range(min=0),
+        cv.Optional(CONF_MIN_LARGEST_BLOCK, default=8192): cv.int_range(min=0),
+        cv.Optional(CONF_MAX_FRAGMENTATION, default=60): cv.int_range(min=0, max=100),
+    }
+)
+
+CONF_HISTORY = "history"
+CONF_PAGE_SIZE = "page_size"
+
+HISTORY_SCHEMA = cv.Schema(
+    {
+        # Messages per gateway/history/response page.
+        cv.Optional(CONF_PAGE_SIZE, default=8): cv.int_range(min=1, max=16),
+    }
+)
+
+# Port names accepted by rate_limit.ports (Meshtastic PortNum values).  Text
+# messages are never rate limited, so TEXT_MESSAGE_APP is not listed.
+PORTNUMS = {
+    "position": 3,
+    "nodeinfo": 4,
+    "telemetry": 67,
+    "traceroute": 70,
+    "neighborinfo": 71,
+}
+
+
+# topic_template placeholder → TopicPart (topic_schema.h).
+TOPIC_PLACEHOLDERS = {
+    "node": "NODE_HEX",
+    "node_lower": "NODE_HEX_LOWER",
+    "node_dec": "NODE_DEC",
+    "channel": "CHANNEL",
+    "suffix": "SUFFIX",
+}
+TOPIC_TEMPLATE_RE = re.compile(r"\{([a-z_]*)\}")
+
+
+def topic_template(value):
+    """Parse a per-node topic template into (TopicPart, literal) segments."""
+    value = cv.string_strict(value)
+    segments = []
+    pos = 0
+    for match in TOPIC_TEMPLATE_RE.finditer(value):
+        if match.start() > pos:
+            segments.append(("LITERAL", value[pos : match.start()]))
+        name = match.group(1)
+        if name not in TOPIC_PLACEHOLDERS:
+            raise cv.Invalid(
+                f"Unknown placeholder '{{{name}}}' in topic_template; "
+                f"valid: {', '.join('{' + p + '}' for p in TOPIC_PLACEHOLDERS)}"
+            )
+        segments.append((TOPIC_PLACEHOLDERS[name], ""))
+        pos = match.end()
+    if pos < len(value):
+        segments.append(("LITERAL", value[pos:]))
+
+    parts = [part for part, _ in segments]
+    if parts.count("SUFFIX") != 1:
+        raise cv.Invalid("topic_template must contain {suffix} exactly once")
+    if not {"NODE_HEX", "NODE_HEX_LOWER", "NODE_DEC"} & set(parts):
+        raise cv.Invalid("topic_template must contain {node}, {node_lower} or {node_dec}")
+    literal = "".join(text for _, text in segments)
+    # Printable ASCII only: one byte per character, so the emitted length is
+    # the byte length and format_topic() can never cut a multi-byte sequence.
+    if any(not " " <= c <= "~" for c in literal):
+        raise cv.Invalid("topic_template literals must be printable ASCII")
+    if any(c in literal for c in '{}+#"\\'):
+        raise cv.Invalid("topic_template literals may not contain {, }, +, #, \" or \\")
+    if value.startswith("/") or value.endswith("/") or "//" in value:
+        raise cv.Invalid("topic_template may not start or end with '/' or contain '//'")
+    if len(literal) > 24:
+        raise cv.Invalid("topic_template literal text is limited to 24 characters")
+    return segments
+
+
+def topic_schema_expression(segments):
+    # topic_template() limits literals to printable ASCII without '"' or '\\',
+    # so they paste into the C++ string literal as is and len() is the byte count.
+    return "{ " + ", ".join(
+        f'{{TopicPart::{part}, "{text}", {len(text)}}}' for part, text in segments
+    ) + " }"
+
+
+def portnum(value):
+    if isinstance(value, int):
+        return cv.int_range(min=0, max=511)(value)
+    return PORTNUMS[cv.one_of(*PORTNUMS, lower=True)(value)]
+
+
+RATE_LIMIT_SCHEMA = cv.Schema(
+    {
+        # One packet per interval on average per (sender, port), with bursts.
+        cv.Optional(CONF_INTERVAL, default="10s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_BURST, default=3): cv.int_range(min=1, max=255),
+        # At most MeshtasticBLEComponent::MAX_PORT_LIMITS (8) overrides.
+        cv.Optional(CONF_PORTS, default=[]): cv.All(
+            cv.ensure_list(
+                cv.Schema(
+                    {
+                        cv.Required(CONF_PORT): portnum,
+                        # 0s disables limiting for this port.
+                        cv.Required(CONF_INTERVAL): cv.positive_time_period_milliseconds,
+                        cv.Optional(CONF_BURST, default=1): cv.int_range(min=1, max=255),
+                    }
+                )
+            ),
+            cv.Length(max=8),
+        ),
+    }
+)
 
 # ── YAML schema ───────────────────────────────────────────────────────────────
 CONFIG_SCHEMA = (
@@ -36,7 +245,43 @@ CONFIG_SCHEMA = (
             cv.Optional(CONF_NODE_NAME): cv.string,
             cv.Optional(CONF_NODE_MAC): cv.mac_address,
             cv.Optional(CONF_TOPIC_PREFIX, default="meshtastic"): cv.string,
+            # Layout of per-node topics under topic_prefix, fixed at compile time.
+            cv.Optional(CONF_TOPIC_TEMPLATE, default="{node}/{suffix}"): topic_template,
             cv.Optional(CONF_RECONNECT_INTERVAL, default=30): cv.positive_int,
+            # Home Assistant MQTT discovery, generated lazily per node.
+            cv.Optional(CONF_DISCOVERY, default=True): cv.boolean,
+            cv.Optional(CONF_DISCOVERY_PREFIX, default="homeassistant"): cv.string,
+            # Minimum gap between two nodes' discovery bursts.
+            cv.Optional(
+                CONF_DISCOVERY_INTERVAL, default="100ms"
+            ): cv.positive_time_period_milliseconds,
+            # Aggregate telemetry into one min/max/mean/last summary per window
+            # and node; 0s publishes every sample as it arrives.
+            cv.Optional(
+                CONF_TELEMETRY_WINDOW, default="0s"
+            ): cv.positive_time_period_milliseconds,
+            # Metrics still published raw when a window is set.
+            cv.Optional(CONF_TELEMETRY_PASSTHROUGH, default=[]): cv.ensure_list(
+                cv.one_of(*TELEMETRY_METRICS, lower=True)
+            ),
+            # How long changed retained node state may wait to be published,
+            # so later changes to the same topic replace it; 0ms sends it at
+            # the end of every loop pass.
+            cv.Optional(
+                CONF_STATE_FLUSH_DEADLINE, default="0ms"
+            ): cv.positive_time_period_milliseconds,
+            # Per-sender, per-port token buckets; omit to disable.
+            cv.Optional(CONF_RATE_LIMIT): RATE_LIMIT_SCHEMA,
+            # Link graph from NeighborInfo / Traceroute / direct receptions.
+            cv.Optional(CONF_TOPOLOGY): TOPOLOGY_SCHEMA,
+            # Cross-gateway deduplication for overlapping gateways.
+            cv.Optional(CONF_CLUSTER): CLUSTER_SCHEMA,
+            # Task stack / heap watermarks on gateway/diagnostics.
+            cv.Optional(CONF_DIAGNOSTICS): DIAGNOSTICS_SCHEMA,
+            # Cache recent text messages and answer gateway/history/request.
+            cv.Optional(CONF_HISTORY): HISTORY_SCHEMA,
+            # Stream the node's logRecord characteristic to MQTT.
+            cv.Optional(CONF_LOG_RECORD): LOG_RECORD_SCHEMA,
         }
     )
     .extend(cv.COMPONENT_SCHEMA)
@@ -62,4 +307,68 @@ async def to_code(config):
     if CONF_NODE_MAC in config:
         cg.add(var.set_node_mac(config[CONF_NODE_MAC].as_hex))
     cg.add(var.set_topic_prefix(config[CONF_TOPIC_PREFIX]))
+    cg.add_define(
+        "MESHTASTIC_TOPIC_SCHEMA",
+        cg.RawExpression(topic_schema_expression(config[CONF_TOPIC_TEMPLATE])),
+    )
     cg.add(var.set_reconnect_interval(config[CONF_RECONNECT_INTERVAL]))
+    cg.add(var.set_discovery(config[CONF_DISCOVERY]))
+    cg.add(var.set_discovery_prefix(config[CONF_DISCOVERY_PREFIX]))
+    cg.add(var.set_discovery_interval(config[CONF_DISCOVERY_INTERVAL]))
+    cg.add(var.set_telemetry_window(config[CONF_TELEMETRY_WINDOW]))
+    passthrough_mask = 0
+    for metric in config[CONF_TELEMETRY_PASSTHROUGH]:
+        passthrough_mask |= 1 << TELEMETRY_METRICS[metric]
+    cg.add(var.set_telemetry_passthrough(passthrough_mask))
+    cg.add(var.set_state_flush_deadline(config[CONF_STATE_FLUSH_DEADLINE]))
+
+    if CONF_TOPOLOGY in config:
+        topology = config[CONF_TOPOLOGY]
+        cg.add(var.set_topology(topology[CONF_INTERVAL], topology[CONF_EDGE_TTL]))
+
+    if CONF_CLUSTER in config:
+        cluster = config[CONF_CLUSTER]
+        topic = cluster.get(CONF_TOPIC, f"{config[CONF_TOPIC_PREFIX]}/cluster")
+        cg.add(
+            var.set_cluster(
+                topic,
+                cluster[CONF_TIE_BREAK],
+                cluster[CONF_DIGEST_INTERVAL],
+                cluster[CONF_HOLD_TIME],
+            )
+        )
+        if CONF_GATEWAY_ID in cluster:
+            cg.add(var.set_cluster_gateway_id(cluster[CONF_GATEWAY_ID]))
+
+    if CONF_DIAGNOSTICS in config:
+        diagnostics = config[CONF_DIAGNOSTICS]
+        cg.add(
+            var.set_diagnostics(
+                diagnostics[CONF_INTERVAL],
+                diagnostics[CONF_MIN_STACK_FREE],
+                diagnostics[CONF_MIN_FREE_HEAP],
+                diagnostics[CONF_MIN_LARGEST_BLOCK],
+                diagnostics[CONF_MAX_FRAGMENTATION],
+            )
+        )
+
+    if CONF_HISTORY in config:
+        cg.add(var.set_history(config[CONF_HISTORY][CONF_PAGE_SIZE]))
+
+    if CONF_LOG_RECORD in config:
+        log_record = config[CONF_LOG_RECORD]
+        cg.add(
+            var.set_log_record(
+                LOG_LEVELS[log_record[CONF_LEVEL]],
+                log_record[CONF_BATCH_SIZE],
+                log_record[CONF_FLUSH_INTERVAL],
+            )
+        )
+
+    if CONF_RATE_LIMIT in config:
+        rate_limit = config[CONF_RATE_LIMIT]
+        cg.add(var.set_rate_limit(rate_limit[CONF_INTERVAL], rate_limit[CONF_BURST]))
+        for port in rate_limit[CONF_PORTS]:
+            cg.add(
+                var.add_port_limit(port[CONF_PORT], port[CONF_INTERVAL], port[CONF_BURST])
+            )
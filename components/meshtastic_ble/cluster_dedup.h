@@ -0,0 +1,205 @@
+#pragma once
+
+// Cross-gateway deduplication state, kept free of ESPHome / NimBLE / nanopb so
+// it can be exercised on the host (tests/cluster_dedup_test.cpp).
+//
+// Gateways sharing a cluster topic each publish a digest of the packet keys
+// they forwarded.  Keys from peers' digests go into a two-generation Bloom
+// filter (current + previous; the older one is cleared on rotation), and every
+// gateway agrees on a ranking per key: ascending mix32(key ^ gateway_id) among
+// peers heard within CLUSTER_PEER_TTL_MS.  The owner (rank 0) forwards at
+// once; the others hold the packet for rank × hold_time and drop it if the
+// owner's digest reports it first.  The component keeps the held packets and
+// does the forwarding; this class only answers "reported?", "rank?" and
+// builds / parses digests.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "gatt_defs.h"
+
+namespace esphome {
+namespace meshtastic_ble {
+
+// Another gateway seen on the cluster topic.
+struct ClusterPeer {
+    uint32_t gw_id;         // 0 = free slot
+    uint32_t last_seen_ms;  // time its last digest arrived
+};
+
+// Outcome of ClusterFilter::on_digest().
+enum class DigestResult : uint8_t {
+    IGNORED,      // malformed or truncated
+    OWN,          // our own digest echoed back by the broker
+    ACCEPTED,     // keys from a known peer
+    PEER_JOINED,  // keys from a peer not in the table before
+};
+
+// murmur3 finalizer: spreads (key ^ gateway_id) evenly so ownership is
+// balanced whatever the gateway ids look like.
+inline uint32_t mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+class ClusterFilter {
+ public:
+    static constexpr size_t MAX_PEERS = 8;
+    static constexpr size_t DIGEST_MAX_BYTES = CLUSTER_DIGEST_HEADER_LEN + CLUSTER_DIGEST_MAX_KEYS * 4;
+
+    void set_gateway_id(uint32_t gw_id) { gw_id_ = gw_id; }
+    uint32_t gateway_id() const { return gw_id_; }
+
+    // True once a peer's digest has listed `key` (or, rarely, a false
+    // positive).
+    bool reported(uint32_t key) const {
+        const uint32_t h1 = mix32(key);
+        const uint32_t h2 = mix32(key ^ 0x9e3779b9u) | 1;
+        for (const auto &gen : bloom_) {
+            bool all = true;
+            for (uint32_t i = 0; i < CLUSTER_BLOOM_HASHES && all; i++) {
+                const uint32_t bit = (h1 + i * h2) % CLUSTER_BLOOM_BITS;
+                all = (gen[bit / 8] & (1u << (bit % 8))) != 0;
+            }
+            if (all) return true;
+        }
+        return false;
+    }
+
+    // Number of live peers that score lower than this gateway for `key`; 0
+    // means this gateway owns it.
+    uint8_t rank(uint32_t key, uint32_t now) const {
+        const uint32_t mine = mix32(key ^ gw_id_);
+        uint8_t rank = 0;
+        for (const auto &p : peers_) {
+            if (p.gw_id == 0 || now - p.last_seen_ms >= CLUSTER_PEER_TTL_MS) continue;
+            const uint32_t theirs = mix32(key ^ p.gw_id);
+            // Ties (practically impossible) go to the lower gateway id.
+            if (theirs < mine || (theirs == mine && p.gw_id < gw_id_)) rank++;
+        }
+        return rank;
+    }
+
+    // Queue `key` for the next digest.  Beyond CLUSTER_DIGEST_MAX_KEYS pending
+    // keys it is dropped; peers then fall back to their hold timeout.
+    void forwarded(uint32_t key) {
+        if (out_count_ < CLUSTER_DIGEST_MAX_KEYS) out_[out_count_++] = key;
+    }
+
+    size_t pending() const { return out_count_; }
+
+    // A digest is due when it is full, when keys have waited interval_ms, or
+    // as an empty heartbeat CLUSTER_HEARTBEAT_MS after the last attempt (and
+    // right away on start) so peers keep ranking this gateway while it is idle.
+    bool digest_due(uint32_t now, uint32_t interval_ms) const {
+        if (out_count_ >= CLUSTER_DIGEST_MAX_KEYS) return true;
+        const uint32_t since = now - last_digest_ms_;
+        if (!announced_) return since >= interval_ms || last_digest_ms_ == 0;
+        return (out_count_ != 0 && since >= interval_ms) || since >= CLUSTER_HEARTBEAT_MS;
+    }
+
+    // Retire the older Bloom generation once CLUSTER_BLOOM_ROTATE_MS passed.
+    void tick(uint32_t now) {
+        if (now - last_rotate_ms_ >= CLUSTER_BLOOM_ROTATE_MS) rotate_(now);
+    }
+
+    // Encode the pending keys into buf (at least DIGEST_MAX_BYTES) and note
+    // the attempt for digest_due().  Returns the digest length; call
+    // digest_sent() once it was published.
+    size_t write_digest(uint8_t *buf, uint32_t now) {
+        last_digest_ms_ = now;
+        buf[0] = 'M';
+        buf[1] = 'D';
+        buf[2] = CLUSTER_DIGEST_VERSION;
+        buf[3] = static_cast<uint8_t>(out_count_);
+        put32_(buf + 4, gw_id_);
+        for (size_t i = 0; i < out_count_; i++) put32_(buf + CLUSTER_DIGEST_HEADER_LEN + i * 4, out_[i]);
+        return CLUSTER_DIGEST_HEADER_LEN + out_count_ * 4;
+    }
+
+    void digest_sent() {
+        out_count_ = 0;
+        announced_ = true;
+    }
+
+    // Feed a digest received on the cluster topic.  `*gw_id` (optional) is
+    // set to the sender for ACCEPTED and PEER_JOINED.
+    DigestResult on_digest(const uint8_t *p, size_t len, uint32_t now, uint32_t *gw_id = nullptr) {
+        if (len < CLUSTER_DIGEST_HEADER_LEN || p[0] != 'M' || p[1] != 'D' || p[2] != CLUSTER_DIGEST_VERSION) {
+            return DigestResult::IGNORED;
+        }
+        const size_t count = p[3];
+        if (len < CLUSTER_DIGEST_HEADER_LEN + count * 4) return DigestResult::IGNORED;
+        const uint32_t sender = get32_(p + 4);
+        if (sender == gw_id_) return DigestResult::OWN;
+        if (sender == 0) return DigestResult::IGNORED;
+
+        ClusterPeer *slot = nullptr;
+        for (auto &peer : peers_) {
+            if (peer.gw_id == sender) {
+                slot = &peer;
+                break;
+            }
+            if (slot == nullptr || peer.gw_id == 0 ||
+                (slot->gw_id != 0 && now - peer.last_seen_ms > now - slot->last_seen_ms)) {
+                slot = &peer;
+            }
+        }
+        const bool joined = slot->gw_id != sender;
+        slot->gw_id = sender;
+        slot->last_seen_ms = now;
+
+        for (size_t i = 0; i < count; i++) add_(get32_(p + CLUSTER_DIGEST_HEADER_LEN + i * 4), now);
+        if (gw_id != nullptr) *gw_id = sender;
+        return joined ? DigestResult::PEER_JOINED : DigestResult::ACCEPTED;
+    }
+
+ protected:
+    static void put32_(uint8_t *b, uint32_t v) {
+        b[0] = v;
+        b[1] = v >> 8;
+        b[2] = v >> 16;
+        b[3] = v >> 24;
+    }
+
+    static uint32_t get32_(const uint8_t *b) {
+        return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+    }
+
+    void rotate_(uint32_t now) {
+        last_rotate_ms_ = now;
+        bloom_cur_ ^= 1;
+        memset(bloom_[bloom_cur_], 0, sizeof(bloom_[0]));
+        bloom_count_ = 0;
+    }
+
+    void add_(uint32_t key, uint32_t now) {
+        if (bloom_count_ >= CLUSTER_BLOOM_CAPACITY) rotate_(now);
+        const uint32_t h1 = mix32(key);
+        const uint32_t h2 = mix32(key ^ 0x9e3779b9u) | 1;
+        for (uint32_t i = 0; i < CLUSTER_BLOOM_HASHES; i++) {
+            const uint32_t bit = (h1 + i * h2) % CLUSTER_BLOOM_BITS;
+            bloom_[bloom_cur_][bit / 8] |= 1u << (bit % 8);
+        }
+        bloom_count_++;
+    }
+
+    uint32_t gw_id_{0};
+    uint32_t out_[CLUSTER_DIGEST_MAX_KEYS]{};
+    size_t out_count_{0};
+    uint8_t bloom_[2][CLUSTER_BLOOM_BITS / 8]{};
+    uint8_t bloom_cur_{0};
+    uint16_t bloom_count_{0};  // keys inserted into the current generation
+    uint32_t last_rotate_ms_{0};
+    uint32_t last_digest_ms_{0};  // last write_digest() call
+    bool announced_{false};       // a digest has been published
+    ClusterPeer peers_[MAX_PEERS]{};
+};
+
+}  // namespace meshtastic_ble
+}  // namespace esphome
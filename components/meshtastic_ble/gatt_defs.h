@@ -47,6 +47,9 @@
 // adds some overhead.  256 bytes is a safe read buffer for fromRadio.
 #define MESHTASTIC_MAX_PACKET_LEN   512
 
+// Broadcast destination; also used by RouteDiscovery for unknown hops.
+#define MESHTASTIC_BROADCAST_ADDR   0xFFFFFFFF
+
 // ── WantConfig handshake ──────────────────────────────────────────────────────
 // After connecting the client writes a ToRadio{want_config_id: <nonzero>}.
 // The node replies with a stream of FromRadio packets (MyNodeInfo, NodeInfo×N,
@@ -54,7 +57,49 @@
 // Any nonzero 32-bit value works as the handshake ID.
 #define MESHTASTIC_WANT_CONFIG_ID   0xDEADBEEF
 
+// ── Rate limiting ─────────────────────────────────────────────────────────────
+// How often the gateway/throttled diagnostics topic is refreshed.
+#define RATE_LIMIT_REPORT_MS        30000
+
+// ── logRecord streaming ───────────────────────────────────────────────────────
+// Upper bound on one gateway/log batch payload.
+#define LOG_BATCH_MAX_BYTES         1024
+
+// ── Text history ──────────────────────────────────────────────────────────────
+// Longest text body cached (Data.payload max_size in mesh.options).
+#define HISTORY_TEXT_MAX_LEN        233
+// Upper bound on one gateway/history/response page.
+#define HISTORY_PAGE_MAX_BYTES      1536
+
+// ── Cross-gateway deduplication ───────────────────────────────────────────────
+// Digest wire format (little-endian):
+//   'M' 'D' <version u8> <count u8> <gateway_id u32> <key u32> × count
+// where key = FNV-1a of (from, id) of a packet the sender forwarded.
+#define CLUSTER_DIGEST_VERSION      1
+#define CLUSTER_DIGEST_HEADER_LEN   8
+#define CLUSTER_DIGEST_MAX_KEYS     64
+// Peer filter: two generations of CLUSTER_BLOOM_BITS bits, k = 3.  A
+// generation is retired after CLUSTER_BLOOM_CAPACITY keys (~2% false
+// positives at that fill) or CLUSTER_BLOOM_ROTATE_MS, whichever comes first.
+#define CLUSTER_BLOOM_BITS          4096
+#define CLUSTER_BLOOM_HASHES        3
+#define CLUSTER_BLOOM_CAPACITY      400
+#define CLUSTER_BLOOM_ROTATE_MS     60000
+// A peer that sent no digest for this long no longer takes part in tie-breaks.
+#define CLUSTER_PEER_TTL_MS         60000
+// An idle gateway still sends an empty digest this often, so peers keep it in
+// their ranking on a mesh quieter than one packet per CLUSTER_PEER_TTL_MS.
+#define CLUSTER_HEARTBEAT_MS        (CLUSTER_PEER_TTL_MS / 3)
+
+// ── Mesh topology ─────────────────────────────────────────────────────────────
+// Edges per topology delta message (~30 bytes each on the wire).
+#define TOPOLOGY_EDGES_PER_MSG      32
+// Minimum SNR change (× 4 dB) that marks a known edge dirty.
+#define TOPOLOGY_SNR_HYSTERESIS_Q4  4
+
 // ── Topic suffixes (used by MeshtasticBLEComponent when publishing) ───────────
+// Per-node topics are <topic_prefix>/<topic_template with {suffix} = one of
+// these>; see topic_schema.h.
 #define TOPIC_TEXT          "text"
 #define TOPIC_POSITION_LAT  "position/latitude"
 #define TOPIC_POSITION_LON  "position/longitude"
@@ -63,7 +108,20 @@
 #define TOPIC_TEL_VOLTAGE   "telemetry/voltage"
 #define TOPIC_TEL_TEMP      "telemetry/temperature"
 #define TOPIC_TEL_HUMIDITY  "telemetry/humidity"
+#define TOPIC_TEL_SUMMARY   "summary"       // <metric>/summary — windowed min/max/mean/last (JSON)
 #define TOPIC_NODEINFO_NAME "nodeinfo/long_name"
 #define TOPIC_NODEINFO_HW   "nodeinfo/hw_model"
 #define TOPIC_RAW           "raw"           // base64-encoded raw MeshPacket
 #define TOPIC_AVAILABILITY  "status"        // "online" / "offline"
+#define TOPIC_RESYNC        "resync"        // per-resync retained publish summary (JSON)
+#define TOPIC_THROTTLED     "throttled"     // rate-limited (node, port) list (JSON)
+#define TOPIC_LOG           "log"           // batched LogRecord lines; "log/dropped" = overflow count
+#define TOPIC_TOPOLOGY      "topology"      // link-graph deltas (JSON); "topology/get" requests a full resend
+#define TOPIC_DIAGNOSTICS   "diagnostics"   // task stack / heap watermarks and alerts (JSON)
+#define TOPIC_HISTORY       "history"       // "history/request" in, "history/response" pages out (JSON)
+
+// ── Home Assistant discovery ──────────────────────────────────────────────────
+// HA publishes "online" to <discovery_prefix>/status when it (re)starts; configs
+// are sent non-retained and replayed on that birth message.
+#define HA_STATUS_SUFFIX    "status"
+#define HA_DISCOVERY_MAX_LEN 512   // rendered config payload buffer
@@ -1,7 +1,13 @@
 #include "meshtastic_ble.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
 #include "esphome/core/log.h"
 #include "esphome/core/application.h"
+#include "esphome/core/helpers.h"
 
 // NimBLE host
 #include "nimble/nimble_port.h"
@@ -12,6 +18,8 @@
 #include "host/util/util.h"
 #include "services/gap/ble_svc_gap.h"
 
+#include "esp_heap_caps.h"
+
 namespace esphome {
 namespace meshtastic_ble {
 
@@ -20,6 +28,47 @@ namespace meshtastic_ble {
 // Safe because ESPHome creates exactly one instance of this component.
 static MeshtasticBLEComponent *s_instance = nullptr;
 
+// 32-bit FNV-1a.  Used to fingerprint published payloads; 0 is reserved to
+// mean "nothing published yet", so a (rare) zero hash is folded to 1.  Pass a
+// previous result as `seed` to fingerprint several buffers as one.
+static uint32_t fnv1a32(const char *data, size_t len, uint32_t seed = 2166136261u) {
+    uint32_t h = seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 16777619u;
+    }
+    return h != 0 ? h : 1;
+}
+
+// Decode a MeshPacket's Data.payload as the given message type.
+static bool decode_payload(const meshtastic_MeshPacket &pkt, const pb_msgdesc_t *fields, void *dest) {
+    pb_istream_t stream = pb_istream_from_buffer(pkt.decoded.payload.bytes, pkt.decoded.payload.size);
+    if (!pb_decode(&stream, fields, dest)) {
+        ESP_LOGW(TAG, "Failed to decode portnum %d payload from 0x%08X: %s",
+                 pkt.decoded.portnum, pkt.from, stream.errmsg);
+        return false;
+    }
+    return true;
+}
+
+// Indexed by TelemetryMetric.
+static const char *const METRIC_TOPICS[METRIC_COUNT] = {
+    TOPIC_TEL_BATTERY, TOPIC_TEL_VOLTAGE, TOPIC_TEL_TEMP, TOPIC_TEL_HUMIDITY,
+};
+static const char *const METRIC_FORMATS[METRIC_COUNT] = {"%.0f", "%.2f", "%.1f", "%.1f"};
+
+// SNR in dB → the ×4 fixed-point form used by RouteDiscovery, clamped to int8.
+static int8_t snr_to_q4(float snr) {
+    const long q4 = lroundf(snr * 4.0f);
+    return static_cast<int8_t>(q4 < -127 ? -127 : (q4 > 127 ? 127 : q4));
+}
+
+// Cross-gateway dedup key of a packet: FNV-1a of (from, id).
+static uint32_t packet_key(const meshtastic_MeshPacket &pkt) {
+    const uint32_t ids[2] = {pkt.from, pkt.id};
+    return fnv1a32(reinterpret_cast<const char *>(ids), sizeof(ids));
+}
+
 // ── ESPHome lifecycle ─────────────────────────────────────────────────────────
 
 void MeshtasticBLEComponent::setup() {
@@ -29,6 +78,103 @@ void MeshtasticBLEComponent::setup() {
 
     // Stash the instance pointer for use by static NimBLE callbacks.
     s_instance = this;
+    // setup() runs in the ESPHome loop task; remember it for the stack watermark.
+    loop_task_ = xTaskGetCurrentTaskHandle();
+
+    // HA announces restarts on <discovery_prefix>/status.  Discovery configs
+    // are sent non-retained, so they are replayed when HA comes back online.
+    if (discovery_enabled_ && mqtt::global_mqtt_client != nullptr) {
+        mqtt::global_mqtt_client->subscribe(
+            discovery_prefix_ + "/" HA_STATUS_SUFFIX,
+            [this](const std::string &topic, const std::string &payload) {
+                this->on_ha_status_(payload);
+            });
+    }
+
+    // The coalesce pool is a few KB of MeshPackets; builds without
+    // rate_limit: never pay for it.
+    if (rate_limit_enabled_) {
+        coalesce_.reset(new (std::nothrow) meshtastic_MeshPacket[COALESCE_SLOTS]());
+        if (!coalesce_) {
+            ESP_LOGE(TAG, "No memory for the rate-limit coalesce pool — rate limiting disabled");
+            rate_limit_enabled_ = false;
+        }
+    }
+
+    // setup() runs before the NimBLE host task exists, so log_record_enabled_
+    // is settled before the first logRecord notification can arrive.
+    if (log_record_enabled_) {
+        log_ring_.reset(new (std::nothrow) LogEntry[LOG_RING_SIZE]());
+        if (!log_ring_) {
+            ESP_LOGE(TAG, "No memory for the log ring — log_record disabled");
+            log_record_enabled_ = false;
+        }
+    }
+
+    if (topology_enabled_) {
+        edges_.reset(new (std::nothrow) MeshEdge[MAX_EDGES]());
+        if (!edges_) {
+            ESP_LOGE(TAG, "No memory for the topology edge table — topology disabled");
+            topology_enabled_ = false;
+        }
+    }
+
+    // Any message on gateway/topology/get re-sends every live edge in the
+    // next delta, so a consumer that just started can rebuild the full graph.
+    if (topology_enabled_ && mqtt::global_mqtt_client != nullptr) {
+        mqtt::global_mqtt_client->subscribe(
+            topic_prefix_ + "/gateway/" TOPIC_TOPOLOGY "/get",
+            [this](const std::string &topic, const std::string &payload) {
+                for (size_t i = 0; i < MAX_EDGES; i++) {
+                    if (this->edges_[i].state == EDGE_CLEAN) this->edges_[i].state = EDGE_DIRTY;
+                }
+            });
+    }
+
+    // Cross-gateway dedup: every gateway publishes and listens on the same
+    // topic.  gateway_id defaults to a hash of this device's MAC.
+    if (cluster_enabled_ && cluster_tie_break_) {
+        // Packets are only ever held when gateways rank themselves.
+        cluster_held_.reset(new (std::nothrow) HeldPacket[CLUSTER_HOLD_SLOTS]());
+        if (!cluster_held_) ESP_LOGE(TAG, "No memory for the cluster hold pool — forwarding without holds");
+    }
+    if (cluster_enabled_) {
+        if (cluster_gw_id_ == 0) {
+            uint8_t mac[6];
+            get_mac_address_raw(mac);
+            cluster_gw_id_ = fnv1a32(reinterpret_cast<const char *>(mac), sizeof(mac));
+        }
+        cluster_.set_gateway_id(cluster_gw_id_);
+        ESP_LOGI(TAG, "  Cluster id  : %08X", cluster_gw_id_);
+        if (mqtt::global_mqtt_client != nullptr) {
+            mqtt::global_mqtt_client->subscribe(
+                cluster_topic_,
+                [this](const std::string &topic, const std::string &payload) {
+                    this->on_cluster_digest_(payload);
+                });
+        }
+    }
+
+    if (history_enabled_) {
+        history_.reset(new (std::nothrow) TextEntry[HISTORY_SIZE]());
+        if (!history_) {
+            ESP_LOGE(TAG, "No memory for the text history — history disabled");
+            history_enabled_ = false;
+        }
+    }
+
+    // History requests are JSON: {"id": "...", "since": <seq>, "limit": <n>},
+    // every field optional.  Pages go out on gateway/history/response.
+    if (history_enabled_ && mqtt::global_mqtt_client != nullptr) {
+        mqtt::global_mqtt_client->subscribe_json(
+            topic_prefix_ + "/gateway/" TOPIC_HISTORY "/request",
+            [this](const std::string &topic, JsonObject root) {
+                const char *id = root["id"].is<const char *>() ? root["id"].as<const char *>() : "";
+                const uint32_t since = root["since"].is<uint32_t>() ? root["since"].as<uint32_t>() : 0;
+                const uint32_t limit = root["limit"].is<uint32_t>() ? root["limit"].as<uint32_t>() : 0;
+                this->on_history_request_(id, since, limit);
+            });
+    }
 
     // Publish offline availability immediately so HA marks the gateway
     // unavailable until BLE sync completes and we flip it to online.
@@ -91,6 +237,7 @@ void MeshtasticBLEComponent::on_reset_(int reason) {
         s_instance->state_            = GatewayState::IDLE;
         s_instance->config_complete_  = false;
         s_instance->pending_fromradio_read_ = false;
+        s_instance->fromradio_read_busy_ = false;
         // publish_availability_ calls into MQTT — safe to call here because
         // this callback runs in the NimBLE host task, not an ISR.
         s_instance->publish_availability_(false);
@@ -99,6 +246,7 @@ void MeshtasticBLEComponent::on_reset_(int reason) {
 
 void MeshtasticBLEComponent::nimble_host_task_(void *param) {
     ESP_LOGI(TAG, "NimBLE host task running");
+    if (s_instance != nullptr) s_instance->nimble_task_ = xTaskGetCurrentTaskHandle();
     // nimble_port_run() blocks, processing NimBLE events until
     // nimble_port_stop() is called.  In normal operation this task runs
     // forever alongside the ESPHome loop task.
@@ -110,6 +258,44 @@ void MeshtasticBLEComponent::nimble_host_task_(void *param) {
 void MeshtasticBLEComponent::loop() {
     const uint32_t now = millis();
 
+    // Decode what the NimBLE host task read since the last pass.  All packet
+    // handling happens here, on the loop task.
+    drain_fromradio_();
+
+    if (discovery_enabled_ && now - last_discovery_ms_ >= discovery_interval_ms_) {
+        last_discovery_ms_ = now;
+        pump_discovery_();
+    }
+
+    if (telemetry_window_ms_ != 0) flush_metric_windows_(now);
+
+    if (rate_limit_enabled_) {
+        release_coalesced_(now);
+        if (now - last_throttle_report_ms_ >= RATE_LIMIT_REPORT_MS) {
+            last_throttle_report_ms_ = now;
+            publish_throttle_report_();
+        }
+    }
+
+    if (log_record_enabled_) flush_logs_(now);
+
+    if (cluster_enabled_) {
+        release_held_(now);
+        if (cluster_.digest_due(now, cluster_digest_interval_ms_)) publish_digest_(now);
+    }
+
+    if (history_req_active_) publish_history_page_();
+
+    if (diagnostics_enabled_ && now - last_diagnostics_ms_ >= diagnostics_interval_ms_) {
+        last_diagnostics_ms_ = now;
+        publish_diagnostics_();
+    }
+
+    if (topology_enabled_ && now - last_topology_ms_ >= topology_interval_ms_) {
+        last_topology_ms_ = now;
+        publish_topology_delta_();
+    }
+
     switch (state_) {
         case GatewayState::IDLE:
             if (now - last_connect_attempt_ms_ >= reconnect_interval_s_ * 1000U) {
@@ -121,19 +307,20 @@ void MeshtasticBLEComponent::loop() {
         case GatewayState::WANT_CONFIG:
         case GatewayState::SYNCING:
         case GatewayState::READY:
-            // fromRadio drain: handle_from_radio_() sets this flag when a
-            // packet was decoded so more may be queued.  We issue the next
-            // read here, outside the NimBLE callback context.
-            if (pending_fromradio_read_) {
-                pending_fromradio_read_ = false;
-                read_fromradio_();
-            }
+            // fromRadio drain: on_fromradio_read_() sets this flag when a
+            // frame was read so more may be queued.  We issue the next read
+            // here, outside the NimBLE callback context.
+            if (pending_fromradio_read_.exchange(false)) read_fromradio_();
             break;
 
         default:
             // All other states are driven by BLE callbacks.
             break;
     }
+
+    // Retained node state changed during this pass (or, with a deadline,
+    // since the oldest pending change) goes out last, once per topic.
+    flush_node_state_(millis(), false);
 }
 
 void MeshtasticBLEComponent::dump_config() {
@@ -144,6 +331,41 @@ void MeshtasticBLEComponent::dump_config() {
     }
     ESP_LOGCONFIG(TAG, "  MQTT prefix      : %s", topic_prefix_.c_str());
     ESP_LOGCONFIG(TAG, "  Reconnect interval: %us", reconnect_interval_s_);
+    ESP_LOGCONFIG(TAG, "  State flush      : %ums deadline", state_flush_deadline_ms_);
+    if (discovery_enabled_) {
+        ESP_LOGCONFIG(TAG, "  HA discovery     : %s (1 node / %ums)",
+                      discovery_prefix_.c_str(), discovery_interval_ms_);
+    }
+    if (telemetry_window_ms_ != 0) {
+        ESP_LOGCONFIG(TAG, "  Telemetry window : %ums (passthrough mask 0x%02X)",
+                      telemetry_window_ms_, passthrough_mask_);
+    }
+    if (log_record_enabled_) {
+        ESP_LOGCONFIG(TAG, "  logRecord stream : level>=%u, batch %u / %ums",
+                      log_min_level_, log_batch_size_, log_flush_interval_ms_);
+    }
+    if (cluster_enabled_) {
+        ESP_LOGCONFIG(TAG, "  Cluster dedup    : %s as %08X, digest %ums, tie-break %s (hold %ums)",
+                      cluster_topic_.c_str(), cluster_gw_id_, cluster_digest_interval_ms_,
+                      cluster_tie_break_ ? "on" : "off", cluster_hold_ms_);
+    }
+    if (diagnostics_enabled_) {
+        ESP_LOGCONFIG(TAG, "  Diagnostics      : every %ums (alert: stack<%u, heap<%u, block<%u, frag>%u%%)",
+                      diagnostics_interval_ms_, alert_min_stack_free_, alert_min_free_heap_,
+                      alert_min_largest_block_, alert_max_fragmentation_);
+    }
+    if (history_enabled_) {
+        ESP_LOGCONFIG(TAG, "  Text history     : last %u messages, %u per page",
+                      (unsigned) HISTORY_SIZE, history_page_size_);
+    }
+    if (topology_enabled_) {
+        ESP_LOGCONFIG(TAG, "  Topology         : delta every %ums, edge TTL %us",
+                      topology_interval_ms_, edge_ttl_s_);
+    }
+    if (rate_limit_enabled_) {
+        ESP_LOGCONFIG(TAG, "  Rate limit       : 1 / %ums, burst %u (%u port overrides)",
+                      rate_interval_ms_, rate_burst_, (unsigned) port_limit_count_);
+    }
 }
 
 // ── BLE scanning & connecting ─────────────────────────────────────────────────
@@ -226,11 +448,25 @@ void MeshtasticBLEComponent::subscribe_fromnum_() {
     }
 }
 
+void MeshtasticBLEComponent::subscribe_logrecord_() {
+    static const uint8_t cccd_notify[2] = {0x01, 0x00};
+
+    int rc = ble_gattc_write_flat(conn_handle_, logrecord_cccd_handle_,
+                                   cccd_notify, sizeof(cccd_notify),
+                                   on_logrecord_subscribed_, this);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "logRecord CCCD write request failed (rc=%d)", rc);
+        send_want_config_();
+    }
+}
+
 // ── WantConfig handshake ──────────────────────────────────────────────────────
 
 void MeshtasticBLEComponent::send_want_config_() {
     ESP_LOGI(TAG, "Sending WantConfig (id=0x%08X)", want_config_id_);
     state_ = GatewayState::WANT_CONFIG;
+    resync_published_ = 0;
+    resync_skipped_   = 0;
 
     // Encode ToRadio{want_config_id: N} with nanopb.
     // A WantConfig payload is a single varint field — 32 bytes is ample.
@@ -262,20 +498,81 @@ void MeshtasticBLEComponent::send_want_config_() {
 // ── fromRadio read loop ───────────────────────────────────────────────────────
 
 void MeshtasticBLEComponent::read_fromradio_() {
-    // Called after each fromNum notification.  Must loop until server returns
-    // an empty (0-byte) response.
+    // Called after each fromNum notification (NimBLE host task) and from
+    // loop() while the drain is in progress.  The node returns one FromRadio
+    // per read and an empty response once its queue is empty.  A read is only
+    // issued if its result has somewhere to go; otherwise loop() retries.
+    if (conn_handle_ == BLE_HS_CONN_HANDLE_NONE || fromradio_handle_ == 0) return;
+    if (frame_head_.load(std::memory_order_relaxed) - frame_tail_.load(std::memory_order_acquire) >=
+        FRAME_RING_SIZE) {
+        pending_fromradio_read_ = true;
+        return;
+    }
+    bool idle = false;
+    if (!fromradio_read_busy_.compare_exchange_strong(idle, true)) {
+        // Another read is in flight; have loop() chain one more after it.
+        pending_fromradio_read_ = true;
+        return;
+    }
+    int rc = ble_gattc_read(conn_handle_, fromradio_handle_, on_fromradio_read_, this);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "fromRadio read failed to start (rc=%d)", rc);
+        fromradio_read_busy_ = false;
+    }
+}
+
+// Runs in the NimBLE host task.  Copy the frame into the hand-off ring and
+// return; decoding happens in loop() via drain_fromradio_().
+int MeshtasticBLEComponent::on_fromradio_read_(uint16_t conn_handle,
+                                                const struct ble_gatt_error *error,
+                                                struct ble_gatt_attr *attr,
+                                                void *arg) {
+    auto *self = static_cast<MeshtasticBLEComponent *>(arg);
+
+    if (error->status != 0 || attr == nullptr) {
+        ESP_LOGW(TAG, "fromRadio read failed (status=%d)", error->status);
+        self->fromradio_read_busy_ = false;
+        return 0;
+    }
+    if (OS_MBUF_PKTLEN(attr->om) == 0) {
+        // Empty response — fromRadio drain complete.
+        self->fromradio_read_busy_ = false;
+        return 0;
+    }
+
+    // read_fromradio_() checked for a free slot before issuing the read.
+    const uint32_t head = self->frame_head_.load(std::memory_order_relaxed);
+    RadioFrame &frame = self->frame_ring_[head % FRAME_RING_SIZE];
+    if (ble_hs_mbuf_to_flat(attr->om, frame.data, sizeof(frame.data), &frame.len) != 0) {
+        ESP_LOGW(TAG, "fromRadio frame too large (%u bytes) — skipped",
+                 (unsigned) OS_MBUF_PKTLEN(attr->om));
+    } else {
+        self->frame_head_.store(head + 1, std::memory_order_release);
+    }
+    self->fromradio_read_busy_ = false;
+
+    // More packets may be waiting.  loop() issues the next ble_gattc_read()
+    // from outside this callback context, which avoids nested GATTC calls
+    // that can deadlock NimBLE on some esp-idf versions.
+    self->pending_fromradio_read_ = true;
+    return 0;
+}
 
-    // TODO:
-    //   ble_gattc_read(conn_handle_, fromradio_handle_, on_fromradio_read_, this);
+// Decode every frame the NimBLE host task has handed over.
+void MeshtasticBLEComponent::drain_fromradio_() {
+    const uint32_t head = frame_head_.load(std::memory_order_acquire);
+    for (uint32_t tail = frame_tail_.load(std::memory_order_relaxed); tail != head; tail++) {
+        const RadioFrame &frame = frame_ring_[tail % FRAME_RING_SIZE];
+        handle_from_radio_(frame.data, frame.len);
+        frame_tail_.store(tail + 1, std::memory_order_release);
+    }
 }
 
 // ── Packet handling ───────────────────────────────────────────────────────────
 
+// Runs in loop(), one call per frame from the hand-off ring.
 void MeshtasticBLEComponent::handle_from_radio_(const uint8_t *data, size_t len) {
-    if (len == 0) {
-        // Empty response — fromRadio drain complete.
-        return;
-    }
+    if (len == 0) return;
 
     meshtastic_FromRadio from_radio = meshtastic_FromRadio_init_zero;
     pb_istream_t stream = pb_istream_from_buffer(data, len);
@@ -298,15 +595,14 @@ void MeshtasticBLEComponent::handle_from_radio_(const uint8_t *data, size_t len)
         case meshtastic_FromRadio_config_complete_id_tag:
             handle_config_complete_(from_radio.payload_variant.config_complete_id);
             break;
+        case meshtastic_FromRadio_log_record_tag:
+            // Firmware with the debug log API enabled streams logs here too.
+            if (log_record_enabled_) enqueue_log_(from_radio.payload_variant.log_record);
+            break;
         default:
             ESP_LOGD(TAG, "Unhandled FromRadio variant: %d", from_radio.which_payload_variant);
             break;
     }
-
-    // Signal that more packets may be waiting.  loop() will issue the next
-    // ble_gattc_read() from outside this callback context, which avoids nested
-    // GATTC calls that can deadlock NimBLE on some esp-idf versions.
-    pending_fromradio_read_ = true;
 }
 
 void MeshtasticBLEComponent::handle_mesh_packet_(const meshtastic_MeshPacket &pkt) {
@@ -317,25 +613,559 @@ void MeshtasticBLEComponent::handle_mesh_packet_(const meshtastic_MeshPacket &pk
 
     ESP_LOGD(TAG, "MeshPacket from=0x%08X id=0x%08X", pkt.from, pkt.id);
 
-    // TODO: decode pkt.decoded (meshtastic_Data) and route by portnum
-    //
-    // switch (pkt.decoded.portnum) {
-    //     case meshtastic_PortNum_TEXT_MESSAGE_APP:
-    //         publish_(node_topic_(pkt.from, TOPIC_TEXT),
-    //                  std::string((char *)pkt.decoded.payload.bytes, pkt.decoded.payload.size));
-    //         break;
-    //     case meshtastic_PortNum_TELEMETRY_APP:
-    //         // decode meshtastic_Telemetry, publish sub-fields
-    //         break;
-    //     case meshtastic_PortNum_POSITION_APP:
-    //         // decode meshtastic_Position, publish lat/lon/alt
-    //         break;
-    //     case meshtastic_PortNum_NODEINFO_APP:
-    //         // decode meshtastic_User, publish long_name/hw_model
-    //         break;
-    //     default:
-    //         break;
-    // }
+    // HA discovery is generated lazily: a node gets entities the first time
+    // it is heard live, not when it is merely replayed from the NodeDB.
+    NodeEntry *node = find_or_add_node_(pkt.from);
+    if (node != nullptr) {
+        if (pkt.rx_time > node->last_heard) node->last_heard = pkt.rx_time;
+        set_node_channel_(*node, pkt.channel);
+        if (node->discovery_hash == 0) node->discovery_pending = true;
+    }
+
+    // hop_limit still equal to hop_start means our radio heard the sender
+    // directly — a first-hand link measurement for the topology graph.
+    if (topology_enabled_ && my_node_num_ != 0 && pkt.hop_start != 0 &&
+        pkt.hop_limit == pkt.hop_start) {
+        update_edge_(pkt.from, my_node_num_, snr_to_q4(pkt.rx_snr));
+    }
+
+    // Text history is kept per gateway, so it caches every message this radio
+    // heard, including ones a cluster peer forwards in its place.
+    if (history_enabled_ && pkt.which_payload_variant == meshtastic_MeshPacket_decoded_tag &&
+        pkt.decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP) {
+        cache_text_(pkt);
+    }
+
+    // With cluster dedup, packets another gateway owns or already forwarded
+    // are skipped (or held until its digest arrives).
+    if (cluster_enabled_ && !cluster_claim_(pkt)) return;
+    forward_packet_(pkt);
+}
+
+void MeshtasticBLEComponent::forward_packet_(const meshtastic_MeshPacket &pkt) {
+    // Over-limit packets are parked (latest value wins) and released by loop().
+    if (!admit_packet_(pkt)) return;
+    dispatch_packet_(pkt);
+}
+
+// Route a decoded MeshPacket by portnum and publish its contents.
+void MeshtasticBLEComponent::dispatch_packet_(const meshtastic_MeshPacket &pkt) {
+    if (pkt.which_payload_variant != meshtastic_MeshPacket_decoded_tag) {
+        ESP_LOGV(TAG, "Packet id=0x%08X is still encrypted — not forwarded", pkt.id);
+        return;
+    }
+    // Peers suppress whatever the digest lists, so only packets actually
+    // published here go in it: one the rate limiter parks is announced when
+    // released, one it replaces or drops never is.
+    if (cluster_enabled_ && pkt.id != 0) cluster_.forwarded(packet_key(pkt));
+
+    switch (pkt.decoded.portnum) {
+        case meshtastic_PortNum_TEXT_MESSAGE_APP: {
+            NodeEntry *node = find_or_add_node_(pkt.from);
+            if (node != nullptr) note_entity_(*node, ENTITY_TEXT);
+            publish_(node_topic_(pkt.from, TOPIC_TEXT),
+                     std::string(reinterpret_cast<const char *>(pkt.decoded.payload.bytes),
+                                 pkt.decoded.payload.size));
+            break;
+        }
+        case meshtastic_PortNum_TELEMETRY_APP:
+            handle_telemetry_(pkt);
+            break;
+        case meshtastic_PortNum_POSITION_APP: {
+            meshtastic_Position pos = meshtastic_Position_init_zero;
+            NodeEntry *node = find_or_add_node_(pkt.from);
+            if (node != nullptr && decode_payload(pkt, meshtastic_Position_fields, &pos)) {
+                apply_position_(*node, pos);
+            }
+            break;
+        }
+        case meshtastic_PortNum_NODEINFO_APP: {
+            meshtastic_User user = meshtastic_User_init_zero;
+            NodeEntry *node = find_or_add_node_(pkt.from);
+            if (node != nullptr && decode_payload(pkt, meshtastic_User_fields, &user)) {
+                apply_user_(*node, user);
+            }
+            break;
+        }
+        case meshtastic_PortNum_NEIGHBORINFO_APP:
+            if (topology_enabled_) handle_neighbor_info_(pkt);
+            break;
+        case meshtastic_PortNum_TRACEROUTE_APP:
+            if (topology_enabled_) handle_traceroute_(pkt);
+            break;
+        default:
+            ESP_LOGV(TAG, "Ignoring portnum %d from 0x%08X", pkt.decoded.portnum, pkt.from);
+            break;
+    }
+}
+
+// ── Cross-gateway deduplication ───────────────────────────────────────────────
+// Gateways in range of the same mesh each publish a digest of the (from, id)
+// keys they forwarded.  A packet whose key is in a peer's digest is skipped.
+// Digests race the packets themselves, so with tie_break every gateway also
+// agrees on a ranking per key (see cluster_dedup.h).  Rank 0 forwards at once;
+// rank n holds the packet for n × hold_time and only forwards it if nobody
+// ranked above it reported it (e.g. they did not hear it).
+
+// Decide what to do with a new packet.  Returns true to forward it now; false
+// if a peer already forwarded it or it is being held for the owner.
+bool MeshtasticBLEComponent::cluster_claim_(const meshtastic_MeshPacket &pkt) {
+    if (pkt.id == 0) return true;  // nothing to correlate on
+    const uint32_t key = packet_key(pkt);
+    if (cluster_.reported(key)) {
+        cluster_suppressed_++;
+        ESP_LOGD(TAG, "Packet id=0x%08X already forwarded by a peer (%u suppressed)",
+                 pkt.id, cluster_suppressed_);
+        return false;
+    }
+
+    const uint32_t now = millis();
+    const uint8_t rank = cluster_held_ ? cluster_.rank(key, now) : 0;
+    if (rank != 0) {
+        for (size_t i = 0; i < CLUSTER_HOLD_SLOTS; i++) {
+            HeldPacket &h = cluster_held_[i];
+            if (h.used) continue;
+            h.pkt = pkt;
+            h.key = key;
+            h.deadline_ms = now + rank * cluster_hold_ms_;
+            h.used = true;
+            return false;
+        }
+        // Hold pool full — fail open; a duplicate is better than a loss.
+    }
+    return true;
+}
+
+// Held packets are dropped once their key shows up in a peer digest, and
+// forwarded when the hold expires without one.
+void MeshtasticBLEComponent::release_held_(uint32_t now) {
+    cluster_.tick(now);
+
+    for (size_t i = 0; cluster_held_ && i < CLUSTER_HOLD_SLOTS; i++) {
+        HeldPacket &h = cluster_held_[i];
+        if (!h.used) continue;
+        if (cluster_.reported(h.key)) {
+            h.used = false;
+            cluster_suppressed_++;
+            continue;
+        }
+        if ((int32_t) (now - h.deadline_ms) < 0) continue;
+        h.used = false;
+        ESP_LOGD(TAG, "No peer forwarded id=0x%08X — forwarding", h.pkt.id);
+        forward_packet_(h.pkt);
+    }
+}
+
+void MeshtasticBLEComponent::on_cluster_digest_(const std::string &payload) {
+    uint32_t gw_id = 0;
+    const DigestResult res = cluster_.on_digest(reinterpret_cast<const uint8_t *>(payload.data()),
+                                                payload.size(), millis(), &gw_id);
+    if (res == DigestResult::PEER_JOINED) {
+        ESP_LOGI(TAG, "Cluster peer %08X joined", gw_id);
+    } else if (res == DigestResult::IGNORED) {
+        ESP_LOGV(TAG, "Ignoring malformed cluster digest (%u bytes)", (unsigned) payload.size());
+    }
+}
+
+// Also sent with no keys as a heartbeat (see ClusterFilter::digest_due()).
+void MeshtasticBLEComponent::publish_digest_(uint32_t now) {
+    uint8_t buf[ClusterFilter::DIGEST_MAX_BYTES];
+    const size_t len = cluster_.write_digest(buf, now);
+    // Keys stay queued while MQTT is down; peers fall back to the hold timeout.
+    if (!publish_raw_(cluster_topic_.c_str(), reinterpret_cast<const char *>(buf), len)) return;
+    cluster_.digest_sent();
+}
+
+// ── Rate limiting ─────────────────────────────────────────────────────────────
+
+const PortLimit *MeshtasticBLEComponent::port_limit_(uint16_t port) const {
+    for (size_t i = 0; i < port_limit_count_; i++) {
+        if (port_limits_[i].port == port) return &port_limits_[i];
+    }
+    return nullptr;
+}
+
+// Add the tokens earned since b.last_ms.  Only the time actually converted
+// into tokens is consumed, so frequent calls do not lose fractional tokens.
+void MeshtasticBLEComponent::refill_bucket_(TokenBucket &b, const PortLimit &limit, uint32_t now) {
+    const uint32_t capacity = limit.burst * 1000u;
+    if (b.tokens_milli >= capacity) {
+        b.last_ms = now;
+        return;
+    }
+    const uint64_t gained = (uint64_t) (now - b.last_ms) * 1000u / limit.interval_ms;
+    if (gained >= capacity - b.tokens_milli) {
+        b.tokens_milli = capacity;
+        b.last_ms = now;
+    } else {
+        b.tokens_milli += (uint32_t) gained;
+        b.last_ms += (uint32_t) (gained * limit.interval_ms / 1000u);
+    }
+}
+
+// Returns true if the packet may be published now.  Otherwise it replaces any
+// packet already held back for the same (sender, port) and false is returned.
+bool MeshtasticBLEComponent::admit_packet_(const meshtastic_MeshPacket &pkt) {
+    if (!rate_limit_enabled_ || pkt.which_payload_variant != meshtastic_MeshPacket_decoded_tag) {
+        return true;
+    }
+    // Text messages are discrete events, not a value that can be coalesced.
+    if (pkt.decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP) return true;
+
+    const uint16_t port = pkt.decoded.portnum;
+    const PortLimit *custom = port_limit_(port);
+    const PortLimit limit = custom != nullptr ? *custom : PortLimit{port, rate_interval_ms_, rate_burst_};
+    if (limit.interval_ms == 0 || limit.burst == 0) return true;
+
+    const uint32_t now = millis();
+    TokenBucket *bucket = nullptr;
+    TokenBucket *victim = nullptr;  // free slot, else least recently refilled idle bucket
+    for (auto &b : buckets_) {
+        if (b.node == pkt.from && b.port == port) {
+            bucket = &b;
+            break;
+        }
+        if (b.pending != 0) continue;
+        if (b.node == 0) {
+            if (victim == nullptr || victim->node != 0) victim = &b;
+        } else if (victim == nullptr || (victim->node != 0 && now - b.last_ms > now - victim->last_ms)) {
+            victim = &b;
+        }
+    }
+    if (bucket == nullptr) {
+        // Every bucket is holding a packet — fail open rather than drop traffic.
+        if (victim == nullptr) return true;
+        *victim = TokenBucket{};
+        victim->node = pkt.from;
+        victim->port = port;
+        victim->last_ms = now;
+        victim->tokens_milli = limit.burst * 1000u;
+        bucket = victim;
+    }
+
+    refill_bucket_(*bucket, limit, now);
+    // A packet already held back must go first, so newer ones join it.
+    if (bucket->pending == 0 && bucket->tokens_milli >= 1000) {
+        bucket->tokens_milli -= 1000;
+        return true;
+    }
+
+    bucket->throttled++;
+    if (bucket->pending == 0) {
+        for (size_t i = 0; i < COALESCE_SLOTS; i++) {
+            if (!coalesce_used_[i]) {
+                coalesce_used_[i] = true;
+                bucket->pending = static_cast<uint8_t>(i + 1);
+                break;
+            }
+        }
+        if (bucket->pending == 0) {
+            rate_limit_dropped_++;
+            ESP_LOGV(TAG, "Coalesce pool full — dropping packet from 0x%08X", pkt.from);
+            return false;
+        }
+    }
+    coalesce_[bucket->pending - 1] = pkt;
+    ESP_LOGV(TAG, "Rate limited 0x%08X port %u — holding latest", pkt.from, port);
+    return false;
+}
+
+// Publish held-back packets whose bucket has earned a token again.
+void MeshtasticBLEComponent::release_coalesced_(uint32_t now) {
+    for (auto &b : buckets_) {
+        if (b.pending == 0) continue;
+        const PortLimit *custom = port_limit_(b.port);
+        const PortLimit limit = custom != nullptr ? *custom : PortLimit{b.port, rate_interval_ms_, rate_burst_};
+        refill_bucket_(b, limit, now);
+        if (b.tokens_milli < 1000) continue;
+
+        b.tokens_milli -= 1000;
+        const size_t slot = b.pending - 1;
+        b.pending = 0;
+        dispatch_packet_(coalesce_[slot]);
+        coalesce_used_[slot] = false;
+    }
+}
+
+// Retained JSON list of (node, port) pairs that were held back since the last
+// report.  Published only while something is throttled, plus once to clear.
+void MeshtasticBLEComponent::publish_throttle_report_() {
+    std::string json = "{\"dropped\":" + std::to_string(rate_limit_dropped_) + ",\"nodes\":[";
+    char entry[64];
+    bool any = false;
+    for (auto &b : buckets_) {
+        if (b.node == 0 || b.throttled == 0) continue;
+        snprintf(entry, sizeof(entry), "%s{\"node\":\"%08X\",\"port\":%u,\"held\":%u}",
+                 any ? "," : "", b.node, b.port, b.throttled);
+        json += entry;
+        b.throttled = 0;
+        any = true;
+    }
+    json += "]}";
+
+    if (!any && !throttle_reported_) return;
+    throttle_reported_ = any;
+    publish_("gateway/" TOPIC_THROTTLED, json, true);
+}
+
+// ── Mesh topology ─────────────────────────────────────────────────────────────
+
+// NeighborInfo: the reporting node lists the neighbours it hears and their SNR.
+void MeshtasticBLEComponent::handle_neighbor_info_(const meshtastic_MeshPacket &pkt) {
+    meshtastic_NeighborInfo info = meshtastic_NeighborInfo_init_zero;
+    if (!decode_payload(pkt, meshtastic_NeighborInfo_fields, &info)) return;
+
+    const uint32_t reporter = info.node_id != 0 ? info.node_id : pkt.from;
+    for (pb_size_t i = 0; i < info.neighbors_count; i++) {
+        update_edge_(info.neighbors[i].node_id, reporter, snr_to_q4(info.neighbors[i].snr));
+    }
+}
+
+// Traceroute replies carry the forward path requester → route[] → responder
+// with snr_towards[] (SNR × 4 at each receiver), and the return path so far in
+// route_back[] / snr_back[].  Requests in flight are partial and ignored.
+void MeshtasticBLEComponent::handle_traceroute_(const meshtastic_MeshPacket &pkt) {
+    if (pkt.decoded.request_id == 0) return;
+    meshtastic_RouteDiscovery rd = meshtastic_RouteDiscovery_init_zero;
+    if (!decode_payload(pkt, meshtastic_RouteDiscovery_fields, &rd)) return;
+
+    // target == 0: the path is still in progress, stop at the last listed hop.
+    auto walk = [this](uint32_t origin, const uint32_t *hops, pb_size_t hop_count,
+                       uint32_t target, const auto *snr, pb_size_t snr_count) {
+        uint32_t prev = origin;
+        const pb_size_t links = target != 0 ? hop_count + 1 : hop_count;
+        for (pb_size_t i = 0; i < links; i++) {
+            const uint32_t next = i < hop_count ? hops[i] : target;
+            const int8_t q4 = (i < snr_count && snr[i] != INT8_MIN)
+                                  ? static_cast<int8_t>(snr[i] < -127 ? -127 : (snr[i] > 127 ? 127 : snr[i]))
+                                  : SNR_UNKNOWN;
+            if (prev != MESHTASTIC_BROADCAST_ADDR && next != MESHTASTIC_BROADCAST_ADDR) {
+                update_edge_(prev, next, q4);
+            }
+            prev = next;
+        }
+    };
+    walk(pkt.to, rd.route, rd.route_count, pkt.from, rd.snr_towards, rd.snr_towards_count);
+    // The return path is only complete once the reply reaches the requester.
+    walk(pkt.from, rd.route_back, rd.route_back_count,
+         pkt.to == my_node_num_ ? pkt.to : 0, rd.snr_back, rd.snr_back_count);
+}
+
+// Insert or refresh the directed edge from → to.  An edge is marked dirty when
+// it is new, returns after being aged out, or its SNR moved by at least the
+// hysteresis since it was last published.
+void MeshtasticBLEComponent::update_edge_(uint32_t from, uint32_t to, int8_t snr_q4) {
+    if (from == 0 || to == 0 || from == to) return;
+    const uint32_t now_s = millis() / 1000;
+
+    MeshEdge *edge = nullptr;
+    MeshEdge *victim = nullptr;  // free slot, else least recently seen edge
+    for (size_t i = 0; i < MAX_EDGES; i++) {
+        MeshEdge &e = edges_[i];
+        if (e.state == EDGE_FREE) {
+            if (victim == nullptr || victim->state != EDGE_FREE) victim = &e;
+            continue;
+        }
+        if (e.from == from && e.to == to) {
+            edge = &e;
+            break;
+        }
+        if (victim == nullptr ||
+            (victim->state != EDGE_FREE && now_s - e.last_seen_s > now_s - victim->last_seen_s)) {
+            victim = &e;
+        }
+    }
+
+    if (edge == nullptr) {
+        *victim = MeshEdge{from, to, now_s, snr_q4, SNR_UNKNOWN, EDGE_DIRTY};
+        return;
+    }
+
+    edge->last_seen_s = now_s;
+    // A hop without SNR does not overwrite a measured value.
+    if (snr_q4 != SNR_UNKNOWN) edge->snr_q4 = snr_q4;
+    if (edge->state == EDGE_REMOVED) {
+        edge->state = EDGE_DIRTY;
+    } else if (edge->state == EDGE_CLEAN && edge->snr_q4 != edge->published_q4 &&
+               (edge->published_q4 == SNR_UNKNOWN ||
+                abs(edge->snr_q4 - edge->published_q4) >= TOPOLOGY_SNR_HYSTERESIS_Q4)) {
+        edge->state = EDGE_DIRTY;
+    }
+}
+
+// Age out stale edges, then publish new / changed / removed edges as compact
+// deltas: {"seq":N,"ttl":S,"up":[["from","to",snr_db|null],…],"rm":[["from","to"],…]}.
+// Consumers apply deltas in seq order and may expire edges themselves after ttl.
+void MeshtasticBLEComponent::publish_topology_delta_() {
+    const uint32_t now_s = millis() / 1000;
+    for (size_t i = 0; i < MAX_EDGES; i++) {
+        MeshEdge &e = edges_[i];
+        if ((e.state == EDGE_CLEAN || e.state == EDGE_DIRTY) && now_s - e.last_seen_s > edge_ttl_s_) {
+            e.state = EDGE_REMOVED;
+        }
+    }
+
+    uint16_t batch[TOPOLOGY_EDGES_PER_MSG];
+    char buf[64 + TOPOLOGY_EDGES_PER_MSG * 40];
+    size_t cursor = 0;
+    while (true) {
+        size_t n = 0;
+        for (; cursor < MAX_EDGES && n < TOPOLOGY_EDGES_PER_MSG; cursor++) {
+            const uint8_t state = edges_[cursor].state;
+            if (state == EDGE_DIRTY || state == EDGE_REMOVED) batch[n++] = cursor;
+        }
+        if (n == 0) return;
+
+        size_t pos = snprintf(buf, sizeof(buf), "{\"seq\":%u,\"ttl\":%u,\"up\":[",
+                              topology_seq_, edge_ttl_s_);
+        bool first = true;
+        for (size_t i = 0; i < n && pos < sizeof(buf); i++) {
+            const MeshEdge &e = edges_[batch[i]];
+            if (e.state != EDGE_DIRTY) continue;
+            if (e.snr_q4 == SNR_UNKNOWN) {
+                pos += snprintf(buf + pos, sizeof(buf) - pos, "%s[\"%08x\",\"%08x\",null]",
+                                first ? "" : ",", e.from, e.to);
+            } else {
+                pos += snprintf(buf + pos, sizeof(buf) - pos, "%s[\"%08x\",\"%08x\",%g]",
+                                first ? "" : ",", e.from, e.to, e.snr_q4 / 4.0f);
+            }
+            first = false;
+        }
+        if (pos < sizeof(buf)) pos += snprintf(buf + pos, sizeof(buf) - pos, "],\"rm\":[");
+        first = true;
+        for (size_t i = 0; i < n && pos < sizeof(buf); i++) {
+            const MeshEdge &e = edges_[batch[i]];
+            if (e.state != EDGE_REMOVED) continue;
+            pos += snprintf(buf + pos, sizeof(buf) - pos, "%s[\"%08x\",\"%08x\"]",
+                            first ? "" : ",", e.from, e.to);
+            first = false;
+        }
+        if (pos < sizeof(buf)) pos += snprintf(buf + pos, sizeof(buf) - pos, "]}");
+        if (pos >= sizeof(buf)) {
+            ESP_LOGW(TAG, "Topology delta truncated — skipping batch");
+            return;
+        }
+
+        // Edge states only advance once the broker has the delta.
+        if (!publish_("gateway/" TOPIC_TOPOLOGY, std::string(buf, pos))) return;
+        topology_seq_++;
+        for (size_t i = 0; i < n; i++) {
+            MeshEdge &e = edges_[batch[i]];
+            if (e.state == EDGE_DIRTY) {
+                e.state = EDGE_CLEAN;
+                e.published_q4 = e.snr_q4;
+            } else {
+                e = MeshEdge{};
+            }
+        }
+    }
+}
+
+// ── Telemetry ─────────────────────────────────────────────────────────────────
+
+void MeshtasticBLEComponent::handle_telemetry_(const meshtastic_MeshPacket &pkt) {
+    meshtastic_Telemetry tel = meshtastic_Telemetry_init_zero;
+    if (!decode_payload(pkt, meshtastic_Telemetry_fields, &tel)) return;
+
+    uint8_t seen = 0;
+
+    switch (tel.which_variant) {
+        case meshtastic_Telemetry_device_metrics_tag: {
+            const auto &m = tel.variant.device_metrics;
+            if (m.has_battery_level) record_metric_(pkt.from, METRIC_BATTERY, m.battery_level);
+            if (m.has_voltage) record_metric_(pkt.from, METRIC_VOLTAGE, m.voltage);
+            seen = (m.has_battery_level ? ENTITY_BATTERY : 0) | (m.has_voltage ? ENTITY_VOLTAGE : 0);
+            break;
+        }
+        case meshtastic_Telemetry_environment_metrics_tag: {
+            const auto &m = tel.variant.environment_metrics;
+            if (m.has_temperature) record_metric_(pkt.from, METRIC_TEMPERATURE, m.temperature);
+            if (m.has_relative_humidity) record_metric_(pkt.from, METRIC_HUMIDITY, m.relative_humidity);
+            seen = (m.has_temperature ? ENTITY_TEMPERATURE : 0) | (m.has_relative_humidity ? ENTITY_HUMIDITY : 0);
+            break;
+        }
+        default:
+            break;
+    }
+
+    NodeEntry *node = seen != 0 ? find_or_add_node_(pkt.from) : nullptr;
+    if (node != nullptr) note_entity_(*node, seen);
+}
+
+// Publish a sample straight through, or fold it into the node's aggregation
+// window when telemetry_window is set and the metric is not passthrough.
+void MeshtasticBLEComponent::record_metric_(uint32_t node_num, TelemetryMetric metric, float value) {
+    if (!metric_aggregated_(metric)) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), METRIC_FORMATS[metric], value);
+        publish_(node_topic_(node_num, METRIC_TOPICS[metric]), buf);
+        return;
+    }
+
+    const uint32_t now = millis();
+    MetricWindow *slot = nullptr;
+    MetricWindow *free_slot = nullptr;
+    MetricWindow *oldest = &agg_[0];
+    for (auto &w : agg_) {
+        if (w.count == 0) {
+            if (free_slot == nullptr) free_slot = &w;
+            continue;
+        }
+        if (w.node == node_num && w.metric == metric) {
+            slot = &w;
+            break;
+        }
+        if (now - w.start_ms > now - oldest->start_ms) oldest = &w;
+    }
+    if (slot == nullptr) slot = free_slot;
+    if (slot == nullptr) {
+        // Table full — close the oldest window early.  If its summary cannot
+        // be sent (MQTT down) it keeps the slot and this sample is dropped.
+        if (!flush_metric_window_(*oldest)) return;
+        slot = oldest;
+    }
+    // A window at UINT16_MAX samples is closed early so n and mean stay
+    // exact; if that fails, only min / max / last keep tracking.
+    if (slot->count == UINT16_MAX && !flush_metric_window_(*slot)) {
+        if (value < slot->min) slot->min = value;
+        if (value > slot->max) slot->max = value;
+        slot->last = value;
+        return;
+    }
+
+    if (slot->count == 0) {
+        slot->node     = node_num;
+        slot->metric   = metric;
+        slot->start_ms = now;
+        slot->min = slot->max = value;
+        slot->sum = 0.0f;
+    }
+    if (value < slot->min) slot->min = value;
+    if (value > slot->max) slot->max = value;
+    slot->sum += value;
+    slot->last = value;
+    slot->count++;
+}
+
+void MeshtasticBLEComponent::flush_metric_windows_(uint32_t now) {
+    for (auto &w : agg_) {
+        if (w.count != 0 && now - w.start_ms >= telemetry_window_ms_) flush_metric_window_(w);
+    }
+}
+
+// Emit one JSON summary for a window and free its slot.  Returns false, with
+// the window kept for the next attempt, if the publish failed.
+bool MeshtasticBLEComponent::flush_metric_window_(MetricWindow &w) {
+    if (w.count == 0) return true;
+    char buf[112];
+    snprintf(buf, sizeof(buf),
+             "{\"min\":%.2f,\"max\":%.2f,\"mean\":%.2f,\"last\":%.2f,\"n\":%u}",
+             w.min, w.max, w.sum / w.count, w.last, (unsigned) w.count);
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), "%s/" TOPIC_TEL_SUMMARY, METRIC_TOPICS[w.metric]);
+    if (!publish_(node_topic_(w.node, suffix), buf)) return false;
+    w.count = 0;
+    return true;
 }
 
 void MeshtasticBLEComponent::handle_my_node_info_(const meshtastic_MyNodeInfo &info) {
@@ -345,7 +1175,49 @@ void MeshtasticBLEComponent::handle_my_node_info_(const meshtastic_MyNodeInfo &i
 
 void MeshtasticBLEComponent::handle_node_info_(const meshtastic_NodeInfo &info) {
     ESP_LOGD(TAG, "NodeInfo: num=0x%08X name=%s", info.num, info.user.long_name);
-    // TODO: store in node table, publish discovery payload
+    if (state_ == GatewayState::WANT_CONFIG) state_ = GatewayState::SYNCING;
+
+    NodeEntry *node = find_or_add_node_(info.num);
+    if (node == nullptr) return;
+    if (info.last_heard > node->last_heard) node->last_heard = info.last_heard;
+    set_node_channel_(*node, info.channel);
+
+    // Every reconnect replays the full NodeDB.  flush_node_state_() compares
+    // each retained payload against the hash of what was last published, so
+    // unchanged names / positions cost nothing on the broker or in HA.
+    if (info.has_user) apply_user_(*node, info.user);
+    if (info.has_position) apply_position_(*node, info.position);
+}
+
+// Store a User (from NodeInfo or a live NODEINFO_APP packet) and publish the
+// retained identity topics that changed.
+void MeshtasticBLEComponent::apply_user_(NodeEntry &node, const meshtastic_User &user) {
+    strncpy(node.long_name, user.long_name, sizeof(node.long_name) - 1);
+    node.long_name[sizeof(node.long_name) - 1] = '\0';
+    strncpy(node.short_name, user.short_name, sizeof(node.short_name) - 1);
+    node.short_name[sizeof(node.short_name) - 1] = '\0';
+    node.hw_model = static_cast<uint8_t>(user.hw_model);
+
+    mark_node_state_(node, RETAINED_LONG_NAME);
+    mark_node_state_(node, RETAINED_HW_MODEL);
+
+    // The device name / model feed the discovery configs; re-render them
+    // and let the content hash decide whether anything needs resending.
+    if (node.discovery_hash != 0) node.discovery_pending = true;
+}
+
+// Store a Position and publish the retained position topics that changed.
+// A 0/0 fix means "no position" in Meshtastic and is ignored.
+void MeshtasticBLEComponent::apply_position_(NodeEntry &node, const meshtastic_Position &pos) {
+    if (pos.latitude_i == 0 && pos.longitude_i == 0) return;
+    node.latitude_i  = pos.latitude_i;
+    node.longitude_i = pos.longitude_i;
+    node.altitude    = pos.altitude;
+
+    mark_node_state_(node, RETAINED_LATITUDE);
+    mark_node_state_(node, RETAINED_LONGITUDE);
+    mark_node_state_(node, RETAINED_ALTITUDE);
+    note_entity_(node, ENTITY_POSITION);
 }
 
 void MeshtasticBLEComponent::handle_config_complete_(uint32_t config_id) {
@@ -358,6 +1230,531 @@ void MeshtasticBLEComponent::handle_config_complete_(uint32_t config_id) {
     state_ = GatewayState::READY;
     config_complete_ = true;
     publish_availability_(true);
+
+    // Send what the replay changed now, so the summary counts all of it.
+    flush_node_state_(millis(), true);
+    ESP_LOGI(TAG, "Resync: %u retained publishes sent, %u avoided (%u nodes known)",
+             resync_published_, resync_skipped_, (unsigned) node_count_);
+    char summary[80];
+    snprintf(summary, sizeof(summary), "{\"published\":%u,\"skipped\":%u,\"nodes\":%u}",
+             resync_published_, resync_skipped_, (unsigned) node_count_);
+    publish_("gateway/" TOPIC_RESYNC, summary);
+}
+
+// ── logRecord streaming ───────────────────────────────────────────────────────
+
+// Runs in the NimBLE host task: decode the notification and hand it to the ring.
+void MeshtasticBLEComponent::handle_log_notify_(struct os_mbuf *om) {
+    uint8_t buf[MESHTASTIC_MAX_PACKET_LEN];
+    uint16_t len = 0;
+    if (ble_hs_mbuf_to_flat(om, buf, sizeof(buf), &len) != 0) {
+        ESP_LOGV(TAG, "logRecord notification too large — dropped");
+        log_dropped_.fetch_add(1);
+        return;
+    }
+
+    meshtastic_LogRecord rec = meshtastic_LogRecord_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(buf, len);
+    if (!pb_decode(&stream, meshtastic_LogRecord_fields, &rec)) {
+        ESP_LOGV(TAG, "Failed to decode LogRecord: %s", stream.errmsg);
+        return;
+    }
+    enqueue_log_(rec);
+}
+
+// Filter by level and push into the ring.  The lock is only ever contended by
+// the other producer for the length of one copy; a full ring is counted as
+// dropped rather than waited on, so BLE packet handling is never held up.
+void MeshtasticBLEComponent::enqueue_log_(const meshtastic_LogRecord &rec) {
+    // Records without a level are treated as INFO.
+    const uint8_t level = rec.level != meshtastic_LogRecord_Level_UNSET
+                              ? static_cast<uint8_t>(rec.level)
+                              : static_cast<uint8_t>(meshtastic_LogRecord_Level_INFO);
+    if (level < log_min_level_) return;
+
+    LockGuard guard(log_push_lock_);
+    const uint32_t head = log_head_.load(std::memory_order_relaxed);
+    if (head - log_tail_.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+        log_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogEntry &e = log_ring_[head % LOG_RING_SIZE];
+    e.time = rec.time;
+    e.queued_ms = millis();
+    e.level = level;
+    strncpy(e.source, rec.source, sizeof(e.source) - 1);
+    e.source[sizeof(e.source) - 1] = '\0';
+    strncpy(e.message, rec.message, sizeof(e.message) - 1);
+    e.message[sizeof(e.message) - 1] = '\0';
+    log_head_.store(head + 1, std::memory_order_release);
+}
+
+static const char *log_level_name(uint8_t level) {
+    if (level >= meshtastic_LogRecord_Level_CRITICAL) return "CRIT";
+    if (level >= meshtastic_LogRecord_Level_ERROR) return "ERROR";
+    if (level >= meshtastic_LogRecord_Level_WARNING) return "WARN";
+    if (level >= meshtastic_LogRecord_Level_INFO) return "INFO";
+    if (level >= meshtastic_LogRecord_Level_DEBUG) return "DEBUG";
+    return "TRACE";
+}
+
+// Publish at most one batch per call, once log_batch_size_ records are queued
+// or the oldest one has waited log_flush_interval_ms_.  Lines are
+// "<time> <LEVEL> [<source>] <message>", newline-separated.
+void MeshtasticBLEComponent::flush_logs_(uint32_t now) {
+    const uint32_t dropped = log_dropped_.load(std::memory_order_relaxed);
+    if (dropped != log_dropped_reported_) {
+        char buf[12];
+        snprintf(buf, sizeof(buf), "%u", dropped);
+        if (publish_("gateway/" TOPIC_LOG "/dropped", buf, true)) log_dropped_reported_ = dropped;
+    }
+
+    const uint32_t tail = log_tail_.load(std::memory_order_relaxed);
+    const uint32_t queued = log_head_.load(std::memory_order_acquire) - tail;
+    if (queued == 0) return;
+    if (queued < log_batch_size_ &&
+        now - log_ring_[tail % LOG_RING_SIZE].queued_ms < log_flush_interval_ms_) {
+        return;
+    }
+
+    char batch[LOG_BATCH_MAX_BYTES];
+    size_t pos = 0;
+    uint32_t taken = 0;
+    while (taken < queued && taken < log_batch_size_) {
+        const LogEntry &e = log_ring_[(tail + taken) % LOG_RING_SIZE];
+        const int n = snprintf(batch + pos, sizeof(batch) - pos, "%s%u %s [%s] %s",
+                               taken == 0 ? "" : "\n", e.time, log_level_name(e.level),
+                               e.source, e.message);
+        if (n < 0 || pos + n >= sizeof(batch)) {
+            // A single oversized line is sent truncated; otherwise it waits
+            // for the next batch.
+            if (taken == 0) {
+                pos = sizeof(batch) - 1;
+                taken = 1;
+            }
+            break;
+        }
+        pos += n;
+        taken++;
+    }
+
+    // Records leave the ring only once the broker accepted the batch; while
+    // MQTT is down the ring fills and further records are counted as dropped.
+    if (!publish_("gateway/" TOPIC_LOG, std::string(batch, pos))) return;
+    log_tail_.store(tail + taken, std::memory_order_release);
+}
+
+// ── Node table ────────────────────────────────────────────────────────────────
+
+NodeEntry *MeshtasticBLEComponent::find_node_(uint32_t num) {
+    for (size_t i = 0; i < node_count_; i++) {
+        if (nodes_[i].num == num) return &nodes_[i];
+    }
+    return nullptr;
+}
+
+NodeEntry *MeshtasticBLEComponent::find_or_add_node_(uint32_t num) {
+    if (num == 0) return nullptr;
+    NodeEntry *node = find_node_(num);
+    if (node != nullptr) return node;
+
+    if (node_count_ < MAX_NODES) {
+        node = &nodes_[node_count_++];
+    } else {
+        // Table full — recycle the least recently heard node.  Its retained
+        // hashes are lost, which only costs one republish if it reappears.
+        node = &nodes_[0];
+        for (size_t i = 1; i < MAX_NODES; i++) {
+            if (nodes_[i].last_heard < node->last_heard) node = &nodes_[i];
+        }
+        ESP_LOGD(TAG, "Node table full — evicting 0x%08X", node->num);
+    }
+    *node = NodeEntry{};
+    node->num = num;
+    return node;
+}
+
+// Record that `node` sent data for an HA entity.  A node that was already
+// announced is re-queued so the new entity shows up; one that was not is left
+// to the lazy first-heard path in handle_mesh_packet_().
+void MeshtasticBLEComponent::note_entity_(NodeEntry &node, uint8_t entity) {
+    if ((node.entities & entity) == entity) return;
+    node.entities |= entity;
+    if (node.discovery_hash != 0) node.discovery_pending = true;
+}
+
+// With a {channel} topic layout a node's topics move with its channel.  Its
+// retained values are re-sent on the new topics (the payload hashes alone
+// would call them unchanged) and its discovery configs, whose state topics
+// embed the channel, are re-rendered so HA follows.
+void MeshtasticBLEComponent::set_node_channel_(NodeEntry &node, uint8_t channel) {
+    if (node.channel == channel) return;
+    node.channel = channel;
+    if constexpr (topic_schema_uses(TopicPart::CHANNEL)) {
+        for (uint8_t slot = 0; slot < RETAINED_SLOT_COUNT; slot++) {
+            if (node.retained_hash[slot] == 0) continue;
+            node.retained_hash[slot] = 0;
+            mark_node_state_(node, static_cast<RetainedSlot>(slot));
+        }
+        if (node.discovery_hash != 0) node.discovery_pending = true;
+    }
+}
+
+// Note that a retained per-node value changed.  Nothing is published here:
+// flush_node_state_() renders the slot from the node's fields at the end of
+// the loop pass, so several changes before then cost one publish.
+void MeshtasticBLEComponent::mark_node_state_(NodeEntry &node, RetainedSlot slot) {
+    const uint8_t bit = 1u << slot;
+    if (node.state_dirty & bit) state_superseded_++;
+    node.state_dirty |= bit;
+    if (!state_dirty_) {
+        state_dirty_ = true;
+        state_dirty_since_ms_ = millis();
+    }
+}
+
+// Render one retained slot into buf; returns its topic suffix.
+const char *MeshtasticBLEComponent::render_node_state_(const NodeEntry &node, RetainedSlot slot,
+                                                        char *buf, size_t size) {
+    switch (slot) {
+        case RETAINED_LONG_NAME:
+            snprintf(buf, size, "%s", node.long_name);
+            return TOPIC_NODEINFO_NAME;
+        case RETAINED_HW_MODEL:
+            snprintf(buf, size, "%u", node.hw_model);
+            return TOPIC_NODEINFO_HW;
+        case RETAINED_LATITUDE:
+            snprintf(buf, size, "%.7f", node.latitude_i * 1e-7);
+            return TOPIC_POSITION_LAT;
+        case RETAINED_LONGITUDE:
+            snprintf(buf, size, "%.7f", node.longitude_i * 1e-7);
+            return TOPIC_POSITION_LON;
+        case RETAINED_ALTITUDE:
+        default:
+            snprintf(buf, size, "%d", node.altitude);
+            return TOPIC_POSITION_ALT;
+    }
+}
+
+// Publish every marked slot whose payload differs from the last one the
+// broker accepted on that topic.  A slot is only cleared (and its hash only
+// updated) once publish_() succeeds, so anything not sent — MQTT down, client
+// refused it — is retried on the next pass.
+void MeshtasticBLEComponent::flush_node_state_(uint32_t now, bool force) {
+    if (!state_dirty_) return;
+    if (!force && state_flush_deadline_ms_ != 0 && now - state_dirty_since_ms_ < state_flush_deadline_ms_) return;
+    if (mqtt::global_mqtt_client == nullptr || !mqtt::global_mqtt_client->is_connected()) return;
+
+    bool left = false;
+    char buf[48];
+    for (size_t i = 0; i < node_count_; i++) {
+        NodeEntry &node = nodes_[i];
+        for (uint8_t slot = 0; slot < RETAINED_SLOT_COUNT && node.state_dirty != 0; slot++) {
+            const uint8_t bit = 1u << slot;
+            if ((node.state_dirty & bit) == 0) continue;
+            const char *suffix = render_node_state_(node, static_cast<RetainedSlot>(slot), buf, sizeof(buf));
+            const uint32_t hash = fnv1a32(buf, strlen(buf));
+            if (node.retained_hash[slot] == hash) {
+                resync_skipped_++;
+            } else if (publish_(node_topic_(node.num, suffix), buf, true)) {
+                node.retained_hash[slot] = hash;
+                resync_published_++;
+                state_sent_++;
+            } else {
+                left = true;
+                continue;
+            }
+            node.state_dirty &= ~bit;
+        }
+    }
+    state_dirty_ = left;
+}
+
+// ── Home Assistant discovery ──────────────────────────────────────────────────
+
+// One HA entity per node and row, announced once the node has sent data for
+// it (NodeEntry::entities).  `extra` is a pre-rendered JSON fragment appended
+// verbatim, so each config renders with a single snprintf into a stack
+// buffer — no JSON document or heap allocation per entity.
+struct DiscoveryEntity {
+    uint8_t entity;            // NodeEntity bit
+    const char *component;     // HA platform
+    const char *object_id;
+    const char *name;
+    const char *state_suffix;  // TOPIC_* suffix under the node topic
+    int8_t metric;             // TelemetryMetric, or -1 if not telemetry
+    const char *extra;
+};
+
+static const DiscoveryEntity DISCOVERY_ENTITIES[] = {
+    {ENTITY_BATTERY, "sensor", "battery", "Battery", TOPIC_TEL_BATTERY, METRIC_BATTERY,
+     ",\"unit_of_meas\":\"%\",\"dev_cla\":\"battery\",\"stat_cla\":\"measurement\""},
+    {ENTITY_VOLTAGE, "sensor", "voltage", "Voltage", TOPIC_TEL_VOLTAGE, METRIC_VOLTAGE,
+     ",\"unit_of_meas\":\"V\",\"dev_cla\":\"voltage\",\"stat_cla\":\"measurement\""},
+    {ENTITY_TEMPERATURE, "sensor", "temperature", "Temperature", TOPIC_TEL_TEMP, METRIC_TEMPERATURE,
+     ",\"unit_of_meas\":\"°C\",\"dev_cla\":\"temperature\",\"stat_cla\":\"measurement\""},
+    {ENTITY_HUMIDITY, "sensor", "humidity", "Humidity", TOPIC_TEL_HUMIDITY, METRIC_HUMIDITY,
+     ",\"unit_of_meas\":\"%\",\"dev_cla\":\"humidity\",\"stat_cla\":\"measurement\""},
+    {ENTITY_POSITION, "sensor", "latitude", "Latitude", TOPIC_POSITION_LAT, -1, ",\"unit_of_meas\":\"°\""},
+    {ENTITY_POSITION, "sensor", "longitude", "Longitude", TOPIC_POSITION_LON, -1, ",\"unit_of_meas\":\"°\""},
+    {ENTITY_POSITION, "sensor", "altitude", "Altitude", TOPIC_POSITION_ALT, -1,
+     ",\"unit_of_meas\":\"m\",\"dev_cla\":\"distance\""},
+    {ENTITY_TEXT, "sensor", "text", "Last message", TOPIC_TEXT, -1, ",\"ic\":\"mdi:message-text\""},
+};
+
+// Arguments: name, node, object_id, state topic, value template, topic prefix,
+// extra, node, device name, hw model.
+static const char DISCOVERY_CONFIG_FMT[] =
+    "{\"name\":\"%s\",\"uniq_id\":\"mesh_%08x_%s\",\"stat_t\":\"%s\"%s,"
+    "\"avty_t\":\"%s/gateway/" TOPIC_AVAILABILITY "\"%s,"
+    "\"dev\":{\"ids\":[\"mesh_%08x\"],\"name\":\"%s\",\"mdl\":\"%u\",\"mf\":\"Meshtastic\"}}";
+
+// Copy `in` into `out` as the body of a JSON string: quotes and backslashes are
+// escaped, control characters dropped.  Always NUL-terminates.
+static void json_escape(const char *in, char *out, size_t size) {
+    size_t o = 0;
+    for (; *in != '\0' && o + 2 < size; in++) {
+        const char c = *in;
+        if (static_cast<uint8_t>(c) < 0x20) continue;
+        if (c == '"' || c == '\\') out[o++] = '\\';
+        out[o++] = c;
+    }
+    out[o] = '\0';
+}
+
+void MeshtasticBLEComponent::on_ha_status_(const std::string &payload) {
+    if (payload != "online") return;
+
+    // HA restarted and forgot the non-retained configs.  Re-queue every node
+    // that had been discovered; clearing the hash forces the resend.
+    size_t queued = 0;
+    for (size_t i = 0; i < node_count_; i++) {
+        if (nodes_[i].discovery_hash == 0) continue;
+        nodes_[i].discovery_hash = 0;
+        nodes_[i].discovery_pending = true;
+        queued++;
+    }
+    ESP_LOGI(TAG, "Home Assistant online — re-queued discovery for %u nodes", (unsigned) queued);
+}
+
+void MeshtasticBLEComponent::pump_discovery_() {
+    if (mqtt::global_mqtt_client == nullptr || !mqtt::global_mqtt_client->is_connected()) return;
+
+    // At most one node per call; discovery_interval_ms_ paces the rest so a
+    // large mesh never blocks loop() or floods the MQTT outbox.
+    for (size_t scanned = 0; scanned < node_count_; scanned++) {
+        NodeEntry &node = nodes_[discovery_cursor_ % node_count_];
+        discovery_cursor_ = (discovery_cursor_ + 1) % node_count_;
+        if (!node.discovery_pending) continue;
+        if (send_discovery_(node)) node.discovery_pending = false;
+        return;
+    }
+}
+
+// Render the discovery configs for the entities `node` has data for and send
+// them only if their combined hash differs from what was last sent.  A new
+// entity changes the hash, so the set is resent with it.  Returns false if a
+// publish failed so the node stays queued.
+bool MeshtasticBLEComponent::send_discovery_(NodeEntry &node) {
+    if (node.entities == 0) return true;  // nothing to announce; the next live packet re-queues it
+
+    char name[2 * sizeof(node.long_name)];
+    if (node.long_name[0] != '\0') {
+        json_escape(node.long_name, name, sizeof(name));
+    } else {
+        snprintf(name, sizeof(name), "!%08x", node.num);
+    }
+
+    char state_topic[128];
+    int prefix_len = snprintf(state_topic, sizeof(state_topic), "%s/", topic_prefix_.c_str());
+    if (prefix_len < 0 || (size_t) prefix_len >= sizeof(state_topic)) return true;
+
+    char payload[HA_DISCOVERY_MAX_LEN];
+    auto render = [&](const DiscoveryEntity &e) -> size_t {
+        const size_t room = sizeof(state_topic) - prefix_len;
+        const size_t n = format_node_topic_(state_topic + prefix_len, room, node.num, e.state_suffix,
+                                            node.channel);
+        // Aggregated metrics only publish window summaries; point HA at the mean.
+        const bool aggregated = e.metric >= 0 && metric_aggregated_(static_cast<TelemetryMetric>(e.metric));
+        if (aggregated) snprintf(state_topic + prefix_len + n, room - n, "/" TOPIC_TEL_SUMMARY);
+        const int len = snprintf(payload, sizeof(payload), DISCOVERY_CONFIG_FMT,
+                                 e.name, node.num, e.object_id, state_topic,
+                                 aggregated ? ",\"val_tpl\":\"{{ value_json.mean }}\"" : "",
+                                 topic_prefix_.c_str(), e.extra, node.num, name, node.hw_model);
+        return (len < 0 || (size_t) len >= sizeof(payload)) ? 0 : (size_t) len;
+    };
+
+    // Pass 1: fingerprint the set of configs.
+    uint32_t hash = 2166136261u;
+    for (const auto &e : DISCOVERY_ENTITIES) {
+        if ((node.entities & e.entity) == 0) continue;
+        const size_t len = render(e);
+        if (len == 0) {
+            ESP_LOGW(TAG, "Discovery config for 0x%08X/%s truncated", node.num, e.object_id);
+            return true;
+        }
+        hash = fnv1a32(payload, len, hash);
+    }
+    if (hash == node.discovery_hash) return true;
+
+    // Pass 2: something changed (or was never sent) — publish.
+    char topic[160];
+    for (const auto &e : DISCOVERY_ENTITIES) {
+        if ((node.entities & e.entity) == 0) continue;
+        const size_t len = render(e);
+        snprintf(topic, sizeof(topic), "%s/%s/mesh_%08x/%s/config",
+                 discovery_prefix_.c_str(), e.component, node.num, e.object_id);
+        if (!publish_raw_(topic, payload, len)) return false;
+    }
+    node.discovery_hash = hash;
+    ESP_LOGD(TAG, "Sent HA discovery for 0x%08X", node.num);
+    return true;
+}
+
+// ── Diagnostics ───────────────────────────────────────────────────────────────
+
+static const char *const DIAG_ALERT_NAMES[] = {
+    "nimble_stack", "loop_stack", "free_heap", "largest_block", "fragmentation",
+};
+
+// Publish task stack high-water marks and heap state on gateway/diagnostics:
+//   {"nimble_stack_free":B,"loop_stack_free":B,"heap_free":B,"heap_min_free":B,
+//    "heap_largest":B,"frag":%,"frag_avg":%,"frag_trend":%,"state_sent":N,
+//    "state_superseded":N,"alerts":[...]}
+// Stack figures are the least free stack ever seen, in bytes (ESP-IDF's
+// uxTaskGetStackHighWaterMark counts bytes).  frag = 1 - largest/free; its
+// moving average and change since the previous report show slow leaks or
+// fragmentation that a single sample would hide.
+void MeshtasticBLEComponent::publish_diagnostics_() {
+    const int32_t nimble_free = nimble_task_ != nullptr ? (int32_t) uxTaskGetStackHighWaterMark(nimble_task_) : -1;
+    const int32_t loop_free = loop_task_ != nullptr ? (int32_t) uxTaskGetStackHighWaterMark(loop_task_) : -1;
+    const uint32_t heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    const uint32_t heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    const uint32_t heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    const uint16_t frag_x10 = heap_free != 0 ? 1000 - (uint16_t) ((uint64_t) heap_largest * 1000 / heap_free) : 0;
+    if (!frag_sampled_) {
+        frag_avg_x10_ = frag_avg_prev_x10_ = frag_x10;
+        frag_sampled_ = true;
+    } else {
+        // EWMA with alpha = 1/8.
+        frag_avg_x10_ = (uint16_t) ((frag_avg_x10_ * 7 + frag_x10 + 4) / 8);
+    }
+    const int trend_x10 = (int) frag_avg_x10_ - (int) frag_avg_prev_x10_;
+    frag_avg_prev_x10_ = frag_avg_x10_;
+
+    uint8_t alerts = 0;
+    if (nimble_free >= 0 && (uint32_t) nimble_free < alert_min_stack_free_) alerts |= DIAG_ALERT_NIMBLE_STACK;
+    if (loop_free >= 0 && (uint32_t) loop_free < alert_min_stack_free_) alerts |= DIAG_ALERT_LOOP_STACK;
+    if (heap_free < alert_min_free_heap_) alerts |= DIAG_ALERT_FREE_HEAP;
+    if (heap_largest < alert_min_largest_block_) alerts |= DIAG_ALERT_LARGEST_BLOCK;
+    if (frag_x10 > alert_max_fragmentation_ * 10u) alerts |= DIAG_ALERT_FRAGMENTATION;
+
+    char buf[448];
+    size_t pos = snprintf(buf, sizeof(buf),
+                          "{\"nimble_stack_free\":%d,\"loop_stack_free\":%d,\"heap_free\":%u,"
+                          "\"heap_min_free\":%u,\"heap_largest\":%u,\"frag\":%u.%u,"
+                          "\"frag_avg\":%u.%u,\"frag_trend\":%s%d.%d,\"state_sent\":%u,"
+                          "\"state_superseded\":%u,\"alerts\":[",
+                          nimble_free, loop_free, heap_free, heap_min_free, heap_largest,
+                          frag_x10 / 10, frag_x10 % 10, frag_avg_x10_ / 10, frag_avg_x10_ % 10,
+                          trend_x10 < 0 ? "-" : "", std::abs(trend_x10) / 10, std::abs(trend_x10) % 10,
+                          state_sent_, state_superseded_);
+    bool first = true;
+    for (size_t i = 0; i < sizeof(DIAG_ALERT_NAMES) / sizeof(DIAG_ALERT_NAMES[0]); i++) {
+        if ((alerts & (1u << i)) == 0) continue;
+        pos += snprintf(buf + pos, sizeof(buf) - pos, "%s\"%s\"", first ? "" : ",", DIAG_ALERT_NAMES[i]);
+        first = false;
+    }
+    pos += snprintf(buf + pos, sizeof(buf) - pos, "]}");
+
+    // Log only transitions so a sustained condition does not flood the log.
+    if (alerts != alerts_active_) {
+        if (alerts & ~alerts_active_) {
+            ESP_LOGW(TAG, "Diagnostics alert: %s", buf);
+        } else {
+            ESP_LOGI(TAG, "Diagnostics alerts cleared: %s", buf);
+        }
+        alerts_active_ = alerts;
+    }
+    publish_("gateway/" TOPIC_DIAGNOSTICS, std::string(buf, pos));
+}
+
+// ── Text history ──────────────────────────────────────────────────────────────
+
+void MeshtasticBLEComponent::cache_text_(const meshtastic_MeshPacket &pkt) {
+    const uint32_t seq = ++history_seq_;
+    TextEntry &e = history_[(seq - 1) % HISTORY_SIZE];
+    e.seq = seq;
+    e.from = pkt.from;
+    e.to = pkt.to;
+    e.rx_time = pkt.rx_time;
+    e.channel = pkt.channel;
+    const size_t len = std::min<size_t>(pkt.decoded.payload.size, HISTORY_TEXT_MAX_LEN);
+    memcpy(e.body, pkt.decoded.payload.bytes, len);
+    e.body[len] = '\0';
+}
+
+// Start answering a history request.  Messages newer than `since` are sent,
+// capped to the newest `limit` (0 = everything cached).  A new request
+// replaces one still being paged out.
+void MeshtasticBLEComponent::on_history_request_(const char *id, uint32_t since, uint32_t limit) {
+    if (history_req_active_) ESP_LOGD(TAG, "History request superseded");
+
+    // A `since` ahead of our counter means the gateway restarted since the
+    // client last asked — send everything we have.
+    if (since > history_seq_) since = 0;
+    if (limit != 0 && history_seq_ - since > limit) since = history_seq_ - limit;
+
+    strncpy(history_req_id_, id != nullptr ? id : "", sizeof(history_req_id_) - 1);
+    history_req_id_[sizeof(history_req_id_) - 1] = '\0';
+    history_req_cursor_ = since;
+    history_req_end_ = history_seq_;
+    history_req_page_ = 0;
+    history_req_active_ = true;
+}
+
+// Publish the next page of the active request:
+//   {"id":..,"page":n,"last":bool,"newest":seq,"messages":[{"seq","from","to",
+//    "channel","time","text"},...]}
+// Messages that arrive while paging are not included; they already went out live.
+void MeshtasticBLEComponent::publish_history_page_() {
+    // Skip anything overwritten since the request was accepted.
+    const uint32_t oldest = history_seq_ > HISTORY_SIZE ? history_seq_ - HISTORY_SIZE + 1 : 1;
+    uint32_t cursor = std::max(history_req_cursor_, oldest - 1);
+
+    char escaped_id[sizeof(history_req_id_) * 2];
+    json_escape(history_req_id_, escaped_id, sizeof(escaped_id));
+
+    char buf[HISTORY_PAGE_MAX_BYTES];
+    size_t pos = snprintf(buf, sizeof(buf), "{\"id\":\"%s\",\"page\":%u,\"newest\":%u,\"messages\":[",
+                          escaped_id, history_req_page_, history_req_end_);
+    char text[HISTORY_TEXT_MAX_LEN * 2 + 1];
+    uint8_t count = 0;
+    while (cursor < history_req_end_ && count < history_page_size_) {
+        const TextEntry &e = history_[cursor % HISTORY_SIZE];  // slot of seq cursor + 1
+        json_escape(e.body, text, sizeof(text));
+        // Leave room for the closing "],\"last\":false}".
+        const size_t room = sizeof(buf) - pos - 20;
+        const int n = snprintf(buf + pos, room,
+                               "%s{\"seq\":%u,\"from\":\"%08x\",\"to\":\"%08x\",\"channel\":%u,"
+                               "\"time\":%u,\"text\":\"%s\"}",
+                               count == 0 ? "" : ",", e.seq, e.from, e.to, e.channel,
+                               e.rx_time, text);
+        if (n < 0 || (size_t) n >= room) break;  // page full — continue on the next one
+        pos += n;
+        cursor++;
+        count++;
+    }
+    const bool last = cursor >= history_req_end_;
+    pos += snprintf(buf + pos, sizeof(buf) - pos, "],\"last\":%s}", last ? "true" : "false");
+
+    // The page is retried next pass if MQTT is not accepting publishes.
+    if (!publish_("gateway/" TOPIC_HISTORY "/response", std::string(buf, pos))) return;
+    history_req_cursor_ = cursor;
+    history_req_page_++;
+    if (last) history_req_active_ = false;
 }
 
 // ── Deduplication ─────────────────────────────────────────────────────────────
@@ -373,25 +1770,47 @@ bool MeshtasticBLEComponent::is_duplicate_(uint32_t packet_id) {
 
 // ── MQTT helpers ──────────────────────────────────────────────────────────────
 
-void MeshtasticBLEComponent::publish_(const std::string &subtopic,
+bool MeshtasticBLEComponent::publish_(const std::string &subtopic,
                                        const std::string &payload,
                                        bool retain) {
     if (mqtt::global_mqtt_client == nullptr || !mqtt::global_mqtt_client->is_connected()) {
         ESP_LOGV(TAG, "MQTT not ready, dropping: %s", subtopic.c_str());
-        return;
+        return false;
     }
     const std::string full_topic = topic_prefix_ + "/" + subtopic;
-    mqtt::global_mqtt_client->publish(full_topic, payload, 0, retain);
+    return mqtt::global_mqtt_client->publish(full_topic, payload, 0, retain);
+}
+
+bool MeshtasticBLEComponent::publish_raw_(const char *topic, const char *payload, size_t len,
+                                           bool retain) {
+    if (mqtt::global_mqtt_client == nullptr || !mqtt::global_mqtt_client->is_connected()) {
+        ESP_LOGV(TAG, "MQTT not ready, dropping: %s", topic);
+        return false;
+    }
+    return mqtt::global_mqtt_client->publish(topic, payload, len, 0, retain);
 }
 
 void MeshtasticBLEComponent::publish_availability_(bool online) {
     publish_("gateway/" TOPIC_AVAILABILITY, online ? "online" : "offline", true);
 }
 
+// Write the per-node topic (topic_template, "<node>/<suffix>" by default) into
+// buf; returns the length written (excluding NUL).
+size_t MeshtasticBLEComponent::format_node_topic_(char *buf, size_t size, uint32_t node_num,
+                                                  const char *suffix, uint8_t channel) {
+    return format_topic(buf, size, node_num, channel, suffix);
+}
+
 std::string MeshtasticBLEComponent::node_topic_(uint32_t node_num, const char *suffix) {
-    char buf[64];
-    snprintf(buf, sizeof(buf), "%08X/%s", node_num, suffix);
-    return std::string(buf);
+    // Only channel-aware layouts pay for the node table lookup.
+    uint8_t channel = 0;
+    if constexpr (topic_schema_uses(TopicPart::CHANNEL)) {
+        const NodeEntry *node = find_node_(node_num);
+        if (node != nullptr) channel = node->channel;
+    }
+    char buf[96];
+    const size_t n = format_node_topic_(buf, sizeof(buf), node_num, suffix, channel);
+    return std::string(buf, n);
 }
 
 // ── Static GAP event trampoline ───────────────────────────────────────────────
@@ -474,6 +1893,9 @@ int MeshtasticBLEComponent::on_gap_event_(struct ble_gap_event *event, void *arg
             if (event->notify_rx.attr_handle == self->fromnum_handle_) {
                 ESP_LOGD(TAG, "fromNum notify — reading fromRadio");
                 self->read_fromradio_();
+            } else if (self->log_record_enabled_ && self->logrecord_handle_ != 0 &&
+                       event->notify_rx.attr_handle == self->logrecord_handle_) {
+                self->handle_log_notify_(event->notify_rx.om);
             }
             break;
 
@@ -551,6 +1973,9 @@ int MeshtasticBLEComponent::on_chr_discovered_(uint16_t conn_handle,
         } else if (ble_uuid_cmp(&chr->uuid.u, &FROMNUM_CHR_UUID.u) == 0) {
             self->fromnum_handle_ = chr->val_handle;
             ESP_LOGI(TAG, "fromNum characteristic handle: %d", self->fromnum_handle_);
+        } else if (ble_uuid_cmp(&chr->uuid.u, &LOGRECORD_CHR_UUID.u) == 0) {
+            self->logrecord_handle_ = chr->val_handle;
+            ESP_LOGI(TAG, "logRecord characteristic handle: %d", self->logrecord_handle_);
         }
         return 0;
     }
@@ -563,11 +1988,16 @@ int MeshtasticBLEComponent::on_chr_discovered_(uint16_t conn_handle,
         return 0;
     }
 
-    // Discover descriptors for the fromNum characteristic to locate its CCCD.
-    // The CCCD descriptor for fromNum lies between fromnum_handle_ and
-    // svc_end_handle_ — using the full service range is safe.
+    // Discover descriptors for the fromNum (and, if streaming logs, logRecord)
+    // characteristics to locate their CCCDs.  Each CCCD lies after its own
+    // value handle, so start at the lower of the two and run to the service end.
+    uint16_t dsc_start = self->fromnum_handle_;
+    if (self->log_record_enabled_ && self->logrecord_handle_ != 0 &&
+        self->logrecord_handle_ < dsc_start) {
+        dsc_start = self->logrecord_handle_;
+    }
     int rc = ble_gattc_disc_all_dscs(conn_handle,
-                                      self->fromnum_handle_,
+                                      dsc_start,
                                       self->svc_end_handle_,
                                       on_desc_discovered_, self);
     if (rc != 0) {
@@ -592,10 +2022,22 @@ int MeshtasticBLEComponent::on_desc_discovered_(uint16_t conn_handle,
     }
 
     if (dsc != nullptr) {
-        // Look for the standard CCCD descriptor (0x2902).
+        // Look for the standard CCCD descriptor (0x2902).  The range may span
+        // several characteristics, so a CCCD belongs to the closest known
+        // characteristic value handle below it.
         if (ble_uuid_cmp(&dsc->uuid.u, &CCCD_UUID.u) == 0) {
-            self->fromnum_cccd_handle_ = dsc->handle;
-            ESP_LOGI(TAG, "fromNum CCCD handle: %d", self->fromnum_cccd_handle_);
+            uint16_t owner = 0;
+            for (uint16_t h : {self->toradio_handle_, self->fromradio_handle_,
+                               self->fromnum_handle_, self->logrecord_handle_}) {
+                if (h != 0 && h < dsc->handle && h > owner) owner = h;
+            }
+            if (owner == self->fromnum_handle_) {
+                self->fromnum_cccd_handle_ = dsc->handle;
+                ESP_LOGI(TAG, "fromNum CCCD handle: %d", self->fromnum_cccd_handle_);
+            } else if (owner != 0 && owner == self->logrecord_handle_) {
+                self->logrecord_cccd_handle_ = dsc->handle;
+                ESP_LOGI(TAG, "logRecord CCCD handle: %d", self->logrecord_cccd_handle_);
+            }
         }
         return 0;
     }
@@ -627,10 +2069,36 @@ int MeshtasticBLEComponent::on_notify_(uint16_t conn_handle,
         return 0;
     }
 
+    if (self->log_record_enabled_ && self->logrecord_cccd_handle_ != 0) {
+        ESP_LOGI(TAG, "fromNum notifications enabled — subscribing to logRecord");
+        self->subscribe_logrecord_();
+        return 0;
+    }
+    if (self->log_record_enabled_) {
+        ESP_LOGW(TAG, "logRecord characteristic not available on this node");
+    }
     ESP_LOGI(TAG, "fromNum notifications enabled — sending WantConfig");
     self->send_want_config_();
     return 0;
 }
 
+// ATT Write Response callback for the logRecord CCCD write.  Log streaming is
+// best-effort: a failure is logged and the handshake continues regardless.
+int MeshtasticBLEComponent::on_logrecord_subscribed_(uint16_t conn_handle,
+                                                      const struct ble_gatt_error *error,
+                                                      struct ble_gatt_attr *attr,
+                                                      void *arg) {
+    auto *self = static_cast<MeshtasticBLEComponent *>(arg);
+
+    if (error->status != 0) {
+        ESP_LOGW(TAG, "logRecord CCCD write failed (status=%d) — continuing without logs",
+                 error->status);
+    } else {
+        ESP_LOGI(TAG, "logRecord notifications enabled");
+    }
+    self->send_want_config_();
+    return 0;
+}
+
 }  // namespace meshtastic_ble
 }  // namespace esphome
@@ -3,9 +3,12 @@
 #include <string>
 #include <cstdint>
 #include <functional>
+#include <atomic>
+#include <memory>
 
 #include "esphome/core/component.h"
 #include "esphome/core/log.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/mqtt/mqtt_client.h"
 
 // NimBLE (available via esp-idf)
@@ -13,8 +16,14 @@
 #include "host/ble_gattc.h"
 #include "nimble/nimble_port.h"
 
+// FreeRTOS task handles for the stack watermarks in gateway/diagnostics
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 #include "gatt_defs.h"   // string UUIDs, topic suffixes, packet constants
 #include "ble_uuids.h"   // NimBLE ble_uuid128_t structs (little-endian byte arrays)
+#include "topic_schema.h" // compile-time per-node topic layout (topic_template)
+#include "cluster_dedup.h" // cross-gateway dedup filter (cluster:)
 
 // nanopb + generated Meshtastic proto headers (produced by scripts/gen_proto.sh)
 #include "proto/meshtastic/mesh.pb.h"
@@ -40,6 +49,29 @@ enum class GatewayState : uint8_t {
 };
 
 // ── Per-node state ────────────────────────────────────────────────────────────
+// Retained per-node topics.  The last payload published to each one is hashed
+// so a WantConfig resync (which replays the whole NodeDB) only republishes the
+// values that actually changed since the previous session.
+enum RetainedSlot : uint8_t {
+    RETAINED_LONG_NAME = 0,
+    RETAINED_HW_MODEL,
+    RETAINED_LATITUDE,
+    RETAINED_LONGITUDE,
+    RETAINED_ALTITUDE,
+    RETAINED_SLOT_COUNT,
+};
+
+// HA entities a node has sent data for (NodeEntry::entities).  Telemetry
+// bits are 1 << TelemetryMetric; discovery only announces set bits.
+enum NodeEntity : uint8_t {
+    ENTITY_BATTERY     = 1 << 0,
+    ENTITY_VOLTAGE     = 1 << 1,
+    ENTITY_TEMPERATURE = 1 << 2,
+    ENTITY_HUMIDITY    = 1 << 3,
+    ENTITY_POSITION    = 1 << 4,  // latitude, longitude, altitude
+    ENTITY_TEXT        = 1 << 5,
+};
+
 struct NodeEntry {
     uint32_t num;
     char long_name[40];
@@ -49,6 +81,124 @@ struct NodeEntry {
     int32_t longitude_i;
     int32_t altitude;
     uint32_t last_heard;  // Unix timestamp from node
+    uint8_t channel;      // channel index last heard on ({channel} in topic_template)
+    // FNV-1a of the last payload published per RetainedSlot; 0 = never published.
+    uint32_t retained_hash[RETAINED_SLOT_COUNT];
+    // Combined hash of the HA discovery configs last sent for this node; 0 = none.
+    uint32_t discovery_hash;
+    bool discovery_pending;  // (re)render discovery on the next pump slot
+    uint8_t entities;        // NodeEntity bits seen so far
+    uint8_t state_dirty;     // RetainedSlot bits changed since the last flush_node_state_()
+};
+
+// ── Telemetry aggregation ─────────────────────────────────────────────────────
+// Metrics the gateway extracts from TELEMETRY_APP packets.  The order matches
+// TELEMETRY_METRICS in __init__.py (bit positions of the passthrough mask).
+enum TelemetryMetric : uint8_t {
+    METRIC_BATTERY = 0,
+    METRIC_VOLTAGE,
+    METRIC_TEMPERATURE,
+    METRIC_HUMIDITY,
+    METRIC_COUNT,
+};
+
+// Running min / max / mean / last for one (node, metric) over the current
+// telemetry window.  count == 0 marks a free slot.
+struct MetricWindow {
+    uint32_t node;
+    uint32_t start_ms;
+    float min;
+    float max;
+    float sum;
+    float last;
+    uint16_t count;
+    uint8_t metric;  // TelemetryMetric
+};
+
+// ── Rate limiting ─────────────────────────────────────────────────────────────
+// Token bucket for one (sender, portnum).  Tokens are kept in thousandths so
+// refill works at millisecond granularity without floats.
+struct TokenBucket {
+    uint32_t node;          // 0 = free slot
+    uint32_t last_ms;       // time of the last refill
+    uint32_t tokens_milli;  // available tokens × 1000
+    uint32_t throttled;     // packets held back since the last diagnostics report
+    uint16_t port;
+    uint8_t pending;        // 1 + coalesce_ slot holding the latest held-back packet, 0 = none
+};
+
+// Limit for one portnum, overriding the default interval / burst.
+struct PortLimit {
+    uint16_t port;
+    uint32_t interval_ms;  // one token per interval; 0 = unlimited
+    uint8_t burst;
+};
+
+// ── Mesh topology ─────────────────────────────────────────────────────────────
+enum EdgeState : uint8_t {
+    EDGE_FREE = 0,  // slot unused
+    EDGE_CLEAN,     // published, unchanged since
+    EDGE_DIRTY,     // new or changed — goes out in the next delta
+    EDGE_REMOVED,   // aged out — removal goes out in the next delta, then freed
+};
+
+// Directed radio link from → to, with the SNR measured by the receiver.
+struct MeshEdge {
+    uint32_t from;
+    uint32_t to;
+    uint32_t last_seen_s;  // uptime seconds
+    int8_t snr_q4;         // SNR × 4 dB; SNR_UNKNOWN if not reported
+    int8_t published_q4;   // snr_q4 as of the last published delta
+    uint8_t state;         // EdgeState
+};
+
+// ── Diagnostics ───────────────────────────────────────────────────────────────
+// Thresholds checked on every gateway/diagnostics report.
+enum DiagAlert : uint8_t {
+    DIAG_ALERT_NIMBLE_STACK = 1 << 0,
+    DIAG_ALERT_LOOP_STACK   = 1 << 1,
+    DIAG_ALERT_FREE_HEAP    = 1 << 2,
+    DIAG_ALERT_LARGEST_BLOCK = 1 << 3,
+    DIAG_ALERT_FRAGMENTATION = 1 << 4,
+};
+
+// ── Cross-gateway deduplication ───────────────────────────────────────────────
+// A packet this gateway does not own, held back for hold_time to see whether
+// the owning gateway reports it in a digest.
+struct HeldPacket {
+    meshtastic_MeshPacket pkt;
+    uint32_t key;
+    uint32_t deadline_ms;
+    bool used;
+};
+
+// ── Text history ──────────────────────────────────────────────────────────────
+// One cached text message.  The body is kept raw and only JSON-escaped when a
+// history page is rendered.
+struct TextEntry {
+    uint32_t seq;      // gateway-assigned, increasing; 0 = empty slot
+    uint32_t from;
+    uint32_t to;
+    uint32_t rx_time;  // node timestamp (epoch seconds, 0 if unknown)
+    uint8_t channel;
+    char body[HISTORY_TEXT_MAX_LEN + 1];
+};
+
+// ── logRecord streaming ───────────────────────────────────────────────────────
+// One decoded LogRecord, truncated to fixed-size fields for the ring buffer.
+struct LogEntry {
+    uint32_t time;       // node timestamp
+    uint32_t queued_ms;  // millis() when queued — drives the time-based flush
+    uint8_t level;       // meshtastic_LogRecord_Level
+    char source[16];
+    char message[120];
+};
+
+// ── fromRadio hand-off ────────────────────────────────────────────────────────
+// One fromRadio read result, copied out of the NimBLE mbuf for loop() to decode.
+struct RadioFrame {
+    uint16_t len;
+    uint8_t data[MESHTASTIC_MAX_PACKET_LEN];
 };
 
 // ── Component ─────────────────────────────────────────────────────────────────
@@ -65,6 +215,53 @@ class MeshtasticBLEComponent : public Component {
     void set_node_mac(uint64_t mac) { node_mac_ = mac; use_mac_ = true; }
     void set_topic_prefix(const std::string &prefix) { topic_prefix_ = prefix; }
     void set_reconnect_interval(uint32_t seconds) { reconnect_interval_s_ = seconds; }
+    void set_state_flush_deadline(uint32_t ms) { state_flush_deadline_ms_ = ms; }
+    void set_discovery(bool enabled) { discovery_enabled_ = enabled; }
+    void set_discovery_prefix(const std::string &prefix) { discovery_prefix_ = prefix; }
+    void set_discovery_interval(uint32_t ms) { discovery_interval_ms_ = ms; }
+    void set_telemetry_window(uint32_t ms) { telemetry_window_ms_ = ms; }
+    void set_telemetry_passthrough(uint8_t mask) { passthrough_mask_ = mask; }
+    void set_rate_limit(uint32_t interval_ms, uint8_t burst) {
+        rate_limit_enabled_ = true;
+        rate_interval_ms_ = interval_ms;
+        rate_burst_ = burst;
+    }
+    void set_log_record(uint8_t min_level, uint8_t batch_size, uint32_t flush_interval_ms) {
+        log_record_enabled_ = true;
+        log_min_level_ = min_level;
+        log_batch_size_ = batch_size;
+        log_flush_interval_ms_ = flush_interval_ms;
+    }
+    void set_cluster(const std::string &topic, bool tie_break, uint32_t digest_interval_ms,
+                     uint32_t hold_time_ms) {
+        cluster_enabled_ = true;
+        cluster_topic_ = topic;
+        cluster_tie_break_ = tie_break;
+        cluster_digest_interval_ms_ = digest_interval_ms;
+        cluster_hold_ms_ = hold_time_ms;
+    }
+    void set_cluster_gateway_id(uint32_t gw_id) { cluster_gw_id_ = gw_id; }
+    void set_diagnostics(uint32_t interval_ms, uint32_t min_stack_free, uint32_t min_free_heap,
+                         uint32_t min_largest_block, uint8_t max_fragmentation) {
+        diagnostics_enabled_ = true;
+        diagnostics_interval_ms_ = interval_ms;
+        alert_min_stack_free_ = min_stack_free;
+        alert_min_free_heap_ = min_free_heap;
+        alert_min_largest_block_ = min_largest_block;
+        alert_max_fragmentation_ = max_fragmentation;
+    }
+    void set_history(uint8_t page_size) {
+        history_enabled_ = true;
+        history_page_size_ = page_size;
+    }
+    void set_topology(uint32_t interval_ms, uint32_t edge_ttl_ms) {
+        topology_enabled_ = true;
+        topology_interval_ms_ = interval_ms;
+        edge_ttl_s_ = edge_ttl_ms / 1000;
+    }
+    void add_port_limit(uint16_t port, uint32_t interval_ms, uint8_t burst) {
+        if (port_limit_count_ < MAX_PORT_LIMITS) port_limits_[port_limit_count_++] = {port, interval_ms, burst};
+    }
 
    private:
     // ── Config ────────────────────────────────────────────────────────────────
@@ -73,6 +270,39 @@ class MeshtasticBLEComponent : public Component {
     bool use_mac_{false};
     std::string topic_prefix_;
     uint32_t reconnect_interval_s_{30};
+    uint32_t state_flush_deadline_ms_{0};  // 0 = flush at the end of every loop()
+    bool discovery_enabled_{true};
+    std::string discovery_prefix_{"homeassistant"};
+    uint32_t discovery_interval_ms_{100};
+    uint32_t telemetry_window_ms_{0};  // 0 = publish every sample
+    uint8_t passthrough_mask_{0};      // bit per TelemetryMetric still published raw
+    bool rate_limit_enabled_{false};
+    uint32_t rate_interval_ms_{10000};
+    uint8_t rate_burst_{3};
+    static constexpr size_t MAX_PORT_LIMITS = 8;
+    PortLimit port_limits_[MAX_PORT_LIMITS]{};
+    size_t port_limit_count_{0};
+    bool log_record_enabled_{false};
+    uint8_t log_min_level_{meshtastic_LogRecord_Level_WARNING};
+    uint8_t log_batch_size_{16};
+    uint32_t log_flush_interval_ms_{5000};
+    bool cluster_enabled_{false};
+    std::string cluster_topic_;
+    uint32_t cluster_gw_id_{0};  // 0 = derive from the WiFi MAC in setup()
+    bool cluster_tie_break_{true};
+    uint32_t cluster_digest_interval_ms_{1000};
+    uint32_t cluster_hold_ms_{1500};
+    bool diagnostics_enabled_{false};
+    uint32_t diagnostics_interval_ms_{60000};
+    uint32_t alert_min_stack_free_{512};        // bytes, either task
+    uint32_t alert_min_free_heap_{20000};
+    uint32_t alert_min_largest_block_{8192};
+    uint8_t alert_max_fragmentation_{60};       // percent
+    bool history_enabled_{false};
+    uint8_t history_page_size_{8};
+    bool topology_enabled_{false};
+    uint32_t topology_interval_ms_{60000};
+    uint32_t edge_ttl_s_{3 * 3600};
 
     // ── BLE state ─────────────────────────────────────────────────────────────
     GatewayState state_{GatewayState::IDLE};
@@ -87,12 +317,101 @@ class MeshtasticBLEComponent : public Component {
     uint16_t fromradio_handle_{0};
     uint16_t fromnum_handle_{0};
     uint16_t fromnum_cccd_handle_{0};
+    uint16_t logrecord_handle_{0};       // optional; 0 if the node does not expose it
+    uint16_t logrecord_cccd_handle_{0};
 
     // ── Session state ─────────────────────────────────────────────────────────
     uint32_t my_node_num_{0};
     uint32_t want_config_id_{MESHTASTIC_WANT_CONFIG_ID};
     bool config_complete_{false};
 
+    // Node table — kept across BLE reconnects so retained-topic hashes survive
+    // the WantConfig replay.  When full, the least recently heard node is evicted.
+    static constexpr size_t MAX_NODES = 256;
+    NodeEntry nodes_[MAX_NODES]{};
+    size_t node_count_{0};
+
+    // Retained publishes issued / avoided during the current WantConfig resync.
+    uint32_t resync_published_{0};
+    uint32_t resync_skipped_{0};
+
+    // Telemetry aggregation windows.  When every slot is busy the oldest window
+    // is closed early, so memory stays fixed regardless of mesh size.
+    static constexpr size_t AGG_SLOTS = 64;
+    MetricWindow agg_[AGG_SLOTS]{};
+
+    // Rate limiting.  Over-limit packets are not published; the latest one per
+    // bucket is parked in coalesce_ and released when a token frees up.  The
+    // pool holds full MeshPackets, so it is only allocated (in setup()) when
+    // rate_limit: is configured.
+    static constexpr size_t MAX_BUCKETS = 64;
+    static constexpr size_t COALESCE_SLOTS = 16;
+    TokenBucket buckets_[MAX_BUCKETS]{};
+    std::unique_ptr<meshtastic_MeshPacket[]> coalesce_;
+    bool coalesce_used_[COALESCE_SLOTS]{};
+    uint32_t rate_limit_dropped_{0};  // held-back packets lost because coalesce_ was full
+    bool throttle_reported_{false};   // last diagnostics report listed at least one node
+
+    // Mesh topology graph.  Bounded; when full the least recently seen edge is
+    // recycled.  Changes are published as deltas every topology_interval_ms_.
+    // The table is ~8 KB, so it is only allocated (in setup()) when topology:
+    // is configured.
+    static constexpr size_t MAX_EDGES = 512;
+    static constexpr int8_t SNR_UNKNOWN = INT8_MIN;
+    std::unique_ptr<MeshEdge[]> edges_;
+    uint32_t topology_seq_{0};
+
+    // LogRecord ring.  Filled from the NimBLE host task (logRecord notify) and
+    // from loop() (FromRadio.log_record); log_push_lock_ serialises the two
+    // producers.  loop() is the only consumer, so it reads without the lock.
+    // When full, new records are dropped and counted rather than blocking BLE.
+    // The ring is allocated in setup() only when log_record: is configured.
+    static constexpr size_t LOG_RING_SIZE = 32;
+    std::unique_ptr<LogEntry[]> log_ring_;
+    Mutex log_push_lock_;
+    std::atomic<uint32_t> log_head_{0};
+    std::atomic<uint32_t> log_tail_{0};
+    std::atomic<uint32_t> log_dropped_{0};
+    uint32_t log_dropped_reported_{0};
+
+    // Recent text messages for gateway/history.  Fixed ring indexed by
+    // (seq - 1) % HISTORY_SIZE; the oldest message is overwritten.  One request
+    // is served at a time, a page per loop() pass.  The ring (~8 KB) is only
+    // allocated in setup() when history: is configured.
+    static constexpr size_t HISTORY_SIZE = 32;
+    std::unique_ptr<TextEntry[]> history_;
+    uint32_t history_seq_{0};          // seq of the newest cached message
+    bool history_req_active_{false};
+    uint32_t history_req_cursor_{0};   // last seq already sent
+    uint32_t history_req_end_{0};      // newest seq when the request arrived
+    uint8_t history_req_page_{0};
+    char history_req_id_[33]{};        // client correlation id, echoed back
+
+    // Cross-gateway deduplication.  cluster_ tracks peers, their reported
+    // keys and the next digest; the hold pool is allocated in setup() only
+    // when cluster: is configured with tie_break.
+    static constexpr size_t CLUSTER_HOLD_SLOTS = 16;
+    ClusterFilter cluster_;
+    std::unique_ptr<HeldPacket[]> cluster_held_;
+    uint32_t cluster_suppressed_{0};   // packets skipped because a peer forwarded them
+
+    // Diagnostics.  Task handles are captured by the tasks themselves; the
+    // NimBLE one is written once from the host task before it is ever read.
+    TaskHandle_t loop_task_{nullptr};
+    TaskHandle_t nimble_task_{nullptr};
+    uint16_t frag_avg_x10_{0};        // fragmentation EWMA, tenths of a percent
+    uint16_t frag_avg_prev_x10_{0};   // frag_avg_x10_ at the previous report
+    bool frag_sampled_{false};
+    uint8_t alerts_active_{0};        // DiagAlert bits raised in the last report
+
+    // Retained node state waiting for flush_node_state_().  Slots are marked
+    // in NodeEntry::state_dirty and rendered from the node's current fields
+    // when flushed, so a value rewritten before the flush is sent once.
+    bool state_dirty_{false};              // some node has state_dirty bits set
+    uint32_t state_dirty_since_ms_{0};     // when the oldest pending change was marked
+    uint32_t state_sent_{0};               // retained node-state publishes accepted by MQTT
+    uint32_t state_superseded_{0};         // changes overwritten before they were flushed
+
     // Seen packet IDs for deduplication (ring buffer, last 64 IDs)
     static constexpr size_t DEDUP_SIZE = 64;
     uint32_t seen_ids_[DEDUP_SIZE]{};
@@ -100,12 +419,30 @@ class MeshtasticBLEComponent : public Component {
 
     // ── Timing ────────────────────────────────────────────────────────────────
     uint32_t last_connect_attempt_ms_{0};
+    uint32_t last_discovery_ms_{0};
+    uint32_t last_throttle_report_ms_{0};
+    uint32_t last_topology_ms_{0};
+    uint32_t last_diagnostics_ms_{0};
+    size_t discovery_cursor_{0};  // round-robin position in nodes_ for pump_discovery_()
+
+    // fromRadio hand-off.  on_fromradio_read_() runs in the NimBLE host task
+    // and only copies the raw frame here; loop() decodes it.  Everything
+    // downstream of handle_from_radio_() (node table, telemetry windows, rate
+    // limiter, topology, history, cluster state) is therefore owned by the
+    // loop task alone, as are the MQTT callbacks that read it.  Single
+    // producer / single consumer, like the log ring.  At most one read is
+    // outstanding, and one is only issued while the ring has room for it.
+    static constexpr size_t FRAME_RING_SIZE = 4;
+    RadioFrame frame_ring_[FRAME_RING_SIZE]{};
+    std::atomic<uint32_t> frame_head_{0};
+    std::atomic<uint32_t> frame_tail_{0};
+    std::atomic<bool> fromradio_read_busy_{false};
 
-    // Set to true by handle_from_radio_() when a non-empty packet was decoded,
-    // signalling that more fromRadio packets may be queued on the node.
-    // Consumed by loop() which issues the next ble_gattc_read() from outside
-    // the NimBLE callback context, avoiding nested GATTC calls.
-    bool pending_fromradio_read_{false};
+    // Set when a non-empty fromRadio frame was read (more may be queued on the
+    // node) or a read had to be deferred.  Consumed by loop() which issues the
+    // next ble_gattc_read() from outside the NimBLE callback context, avoiding
+    // nested GATTC calls.
+    std::atomic<bool> pending_fromradio_read_{false};
 
     // ── NimBLE host lifecycle (static — no instance pointer available yet) ───
     // Called by NimBLE when the host stack has finished initialising and is
@@ -129,6 +466,8 @@ class MeshtasticBLEComponent : public Component {
                                     const struct ble_gatt_dsc *dsc, void *arg);
     static int on_notify_(uint16_t conn_handle, const struct ble_gatt_error *error,
                            struct ble_gatt_attr *attr, void *arg);
+    static int on_logrecord_subscribed_(uint16_t conn_handle, const struct ble_gatt_error *error,
+                                         struct ble_gatt_attr *attr, void *arg);
     static int on_fromradio_read_(uint16_t conn_handle, const struct ble_gatt_error *error,
                                    struct ble_gatt_attr *attr, void *arg);
 
@@ -137,19 +476,71 @@ class MeshtasticBLEComponent : public Component {
     void connect_(const ble_addr_t &addr);
     void discover_services_();
     void subscribe_fromnum_();
+    void subscribe_logrecord_();
     void send_want_config_();
     void read_fromradio_();
+    void drain_fromradio_();
 
     void handle_from_radio_(const uint8_t *data, size_t len);
     void handle_mesh_packet_(const meshtastic_MeshPacket &pkt);
+    void dispatch_packet_(const meshtastic_MeshPacket &pkt);
+    void handle_telemetry_(const meshtastic_MeshPacket &pkt);
+
+    bool cluster_claim_(const meshtastic_MeshPacket &pkt);
+    void forward_packet_(const meshtastic_MeshPacket &pkt);
+    void on_cluster_digest_(const std::string &payload);
+    void release_held_(uint32_t now);
+    void publish_digest_(uint32_t now);
+
+    bool admit_packet_(const meshtastic_MeshPacket &pkt);
+    const PortLimit *port_limit_(uint16_t port) const;
+    void refill_bucket_(TokenBucket &b, const PortLimit &limit, uint32_t now);
+    void release_coalesced_(uint32_t now);
+    void publish_throttle_report_();
+
+    void handle_neighbor_info_(const meshtastic_MeshPacket &pkt);
+    void handle_traceroute_(const meshtastic_MeshPacket &pkt);
+    void update_edge_(uint32_t from, uint32_t to, int8_t snr_q4);
+    void publish_topology_delta_();
+    void publish_diagnostics_();
+    void cache_text_(const meshtastic_MeshPacket &pkt);
+    void on_history_request_(const char *id, uint32_t since, uint32_t limit);
+    void publish_history_page_();
     void handle_my_node_info_(const meshtastic_MyNodeInfo &info);
     void handle_node_info_(const meshtastic_NodeInfo &info);
     void handle_config_complete_(uint32_t config_id);
+    void handle_log_notify_(struct os_mbuf *om);
+    void enqueue_log_(const meshtastic_LogRecord &rec);
+    void flush_logs_(uint32_t now);
 
     bool is_duplicate_(uint32_t packet_id);
 
-    void publish_(const std::string &subtopic, const std::string &payload, bool retain = false);
+    NodeEntry *find_node_(uint32_t num);
+    NodeEntry *find_or_add_node_(uint32_t num);
+    void note_entity_(NodeEntry &node, uint8_t entity);
+    void set_node_channel_(NodeEntry &node, uint8_t channel);
+    void mark_node_state_(NodeEntry &node, RetainedSlot slot);
+    const char *render_node_state_(const NodeEntry &node, RetainedSlot slot, char *buf, size_t size);
+    void flush_node_state_(uint32_t now, bool force);
+    void apply_user_(NodeEntry &node, const meshtastic_User &user);
+    void apply_position_(NodeEntry &node, const meshtastic_Position &pos);
+
+    bool metric_aggregated_(TelemetryMetric metric) const {
+        return telemetry_window_ms_ != 0 && (passthrough_mask_ & (1u << metric)) == 0;
+    }
+    void record_metric_(uint32_t node_num, TelemetryMetric metric, float value);
+    void flush_metric_windows_(uint32_t now);
+    bool flush_metric_window_(MetricWindow &w);
+
+    void on_ha_status_(const std::string &payload);
+    void pump_discovery_();
+    bool send_discovery_(NodeEntry &node);
+
+    bool publish_(const std::string &subtopic, const std::string &payload, bool retain = false);
+    bool publish_raw_(const char *topic, const char *payload, size_t len, bool retain = false);
     void publish_availability_(bool online);
+    size_t format_node_topic_(char *buf, size_t size, uint32_t node_num, const char *suffix,
+                              uint8_t channel = 0);
     std::string node_topic_(uint32_t node_num, const char *suffix);
 };
 
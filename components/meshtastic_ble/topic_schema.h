@@ -0,0 +1,116 @@
+#pragma once
+
+// Per-node MQTT topic layout, fixed at compile time.
+//
+// __init__.py parses the `topic_template` YAML option (e.g. "{node}/{suffix}",
+// "!{node_lower}/{suffix}" or "ch{channel}/{node_dec}/{suffix}") into a list of
+// segments and emits it as the MESHTASTIC_TOPIC_SCHEMA define.  format_topic()
+// is unrolled over that list with `if constexpr`, so each build carries a
+// formatter for exactly its own layout: no template parsing and no snprintf
+// at runtime.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/core/defines.h"
+
+namespace esphome {
+namespace meshtastic_ble {
+
+enum class TopicPart : uint8_t {
+    LITERAL,         // fixed text
+    NODE_HEX,        // {node}        8 upper-case hex digits, e.g. A1B2C3D4
+    NODE_HEX_LOWER,  // {node_lower}  8 lower-case hex digits
+    NODE_DEC,        // {node_dec}    decimal node number
+    CHANNEL,         // {channel}     channel index the node was last heard on
+    SUFFIX,          // {suffix}      value path, e.g. telemetry/voltage
+};
+
+struct TopicSegment {
+    TopicPart part;
+    const char *text;  // LITERAL only
+    size_t len;
+};
+
+#ifndef MESHTASTIC_TOPIC_SCHEMA
+// "{node}/{suffix}" — the layout used before topic_template existed.
+#define MESHTASTIC_TOPIC_SCHEMA \
+    { {TopicPart::NODE_HEX, "", 0}, {TopicPart::LITERAL, "/", 1}, {TopicPart::SUFFIX, "", 0} }
+#endif
+
+inline constexpr TopicSegment TOPIC_SCHEMA[] = MESHTASTIC_TOPIC_SCHEMA;
+inline constexpr size_t TOPIC_SCHEMA_LEN = sizeof(TOPIC_SCHEMA) / sizeof(TOPIC_SCHEMA[0]);
+
+constexpr bool topic_schema_uses(TopicPart part) {
+    for (size_t i = 0; i < TOPIC_SCHEMA_LEN; i++) {
+        if (TOPIC_SCHEMA[i].part == part) return true;
+    }
+    return false;
+}
+
+namespace topic_detail {
+
+// All writers stop at `end`, which is kept one byte short of the buffer end
+// for the terminating NUL.
+inline char *put(char *p, char *end, const char *s, size_t len) {
+    while (len-- != 0 && p < end) *p++ = *s++;
+    return p;
+}
+
+inline char *put_str(char *p, char *end, const char *s) {
+    while (*s != '\0' && p < end) *p++ = *s++;
+    return p;
+}
+
+inline char *put_hex8(char *p, char *end, uint32_t v, const char *digits) {
+    for (int shift = 28; shift >= 0 && p < end; shift -= 4) *p++ = digits[(v >> shift) & 0xF];
+    return p;
+}
+
+inline char *put_dec(char *p, char *end, uint32_t v) {
+    char tmp[10];
+    size_t n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n != 0 && p < end) *p++ = tmp[--n];
+    return p;
+}
+
+template<size_t I>
+inline char *write(char *p, char *end, uint32_t node, uint8_t channel, const char *suffix) {
+    if constexpr (I == TOPIC_SCHEMA_LEN) {
+        return p;
+    } else {
+        constexpr TopicSegment seg = TOPIC_SCHEMA[I];
+        if constexpr (seg.part == TopicPart::LITERAL) {
+            p = put(p, end, seg.text, seg.len);
+        } else if constexpr (seg.part == TopicPart::NODE_HEX) {
+            p = put_hex8(p, end, node, "0123456789ABCDEF");
+        } else if constexpr (seg.part == TopicPart::NODE_HEX_LOWER) {
+            p = put_hex8(p, end, node, "0123456789abcdef");
+        } else if constexpr (seg.part == TopicPart::NODE_DEC) {
+            p = put_dec(p, end, node);
+        } else if constexpr (seg.part == TopicPart::CHANNEL) {
+            p = put_dec(p, end, channel);
+        } else {
+            p = put_str(p, end, suffix);
+        }
+        return write<I + 1>(p, end, node, channel, suffix);
+    }
+}
+
+}  // namespace topic_detail
+
+// Render the per-node topic (without topic_prefix) into buf, truncating to
+// fit.  Returns the length written, excluding the NUL.
+inline size_t format_topic(char *buf, size_t size, uint32_t node, uint8_t channel, const char *suffix) {
+    if (size == 0) return 0;
+    char *p = topic_detail::write<0>(buf, buf + size - 1, node, channel, suffix);
+    *p = '\0';
+    return static_cast<size_t>(p - buf);
+}
+
+}  // namespace meshtastic_ble
+}  // namespace esphome
@@ -10,7 +10,14 @@
 #
 # Output is written to:
 #   components/meshtastic_ble/proto/
+#   components/meshtastic_ble/proto/SIZES.txt   (sizeof() report, see below)
 #   components/meshtastic_ble/nanopb/   (nanopb runtime library files)
+#
+# Sources are generated with scripts/meshtastic_ble.options layered on top of
+# the upstream <proto>.options.  The profile ignores message variants and
+# fields the gateway never reads, which shrinks the decoded structs (and the
+# stack used by handle_from_radio_()).  Set PROTO_PROFILE to another file, or
+# to an empty string to use the upstream options only.
 
 set -euo pipefail
 
@@ -25,6 +32,9 @@ MESHTASTIC_PROTO_VERSION="${MESHTASTIC_PROTO_VERSION:-v2.5}"
 # standalone install.
 NANOPB_VERSION="${NANOPB_VERSION:-0.4.8}"
 
+# nanopb options profile appended to every upstream <proto>.options.
+PROTO_PROFILE="${PROTO_PROFILE-$SCRIPT_DIR/meshtastic_ble.options}"
+
 PROTO_SRC_DIR="$REPO_ROOT/.proto_src"
 PROTO_OUT_DIR="$REPO_ROOT/components/meshtastic_ble/proto"
 NANOPB_DIR="$REPO_ROOT/components/meshtastic_ble/nanopb"
@@ -55,9 +65,6 @@ cp "$TMP_NANOPB/pb.h" \
 NANOPB_GENERATOR="$TMP_NANOPB/generator/nanopb_generator.py"
 
 # ── Generate C sources ────────────────────────────────────────────────────────
-echo "==> Generating nanopb sources..."
-mkdir -p "$PROTO_OUT_DIR/meshtastic"
-
 # The .proto files we need for the BLE API.
 PROTOS=(
     mesh
@@ -69,21 +76,112 @@ PROTOS=(
     xmodem
 )
 
-for proto in "${PROTOS[@]}"; do
-    src="$PROTO_SRC_DIR/meshtastic/${proto}.proto"
-    if [[ ! -f "$src" ]]; then
-        echo "  WARN: ${proto}.proto not found in downloaded archive, skipping"
-        continue
+OPTIONS_TMP="$(mktemp -d)"
+
+# generate <output dir> <profile file or "">
+generate() {
+    local out_dir="$1" profile="$2"
+    mkdir -p "$out_dir/meshtastic"
+    for proto in "${PROTOS[@]}"; do
+        src="$PROTO_SRC_DIR/meshtastic/${proto}.proto"
+        if [[ ! -f "$src" ]]; then
+            echo "  WARN: ${proto}.proto not found in downloaded archive, skipping"
+            continue
+        fi
+        # Later option lines override earlier ones, so the profile goes last.
+        # The merged file replaces the upstream one via the --options-file
+        # pattern (%s expands to "meshtastic/<proto>").
+        opts="$OPTIONS_TMP/options/meshtastic/${proto}.options"
+        mkdir -p "$(dirname "$opts")"
+        : > "$opts"
+        if [[ -f "$PROTO_SRC_DIR/meshtastic/${proto}.options" ]]; then
+            cat "$PROTO_SRC_DIR/meshtastic/${proto}.options" >> "$opts"
+        fi
+        if [[ -n "$profile" ]]; then
+            cat "$profile" >> "$opts"
+        fi
+        echo "  generating ${proto}.pb.{h,c}"
+        python3 "$NANOPB_GENERATOR" \
+            --proto-path="$PROTO_SRC_DIR" \
+            --output-dir="$out_dir" \
+            --options-file="$OPTIONS_TMP/options/%s.options" \
+            "$src"
+    done
+}
+
+if [[ -n "$PROTO_PROFILE" && ! -f "$PROTO_PROFILE" ]]; then
+    echo "ERROR: PROTO_PROFILE=$PROTO_PROFILE does not exist" >&2
+    exit 1
+fi
+
+echo "==> Generating nanopb sources${PROTO_PROFILE:+ (profile: $(basename "$PROTO_PROFILE"))}..."
+generate "$PROTO_OUT_DIR" "$PROTO_PROFILE"
+
+# ── Size report ───────────────────────────────────────────────────────────────
+# Compile a tiny host program against the upstream-only and the profiled
+# headers and record sizeof() of every type the gateway decodes.  Sizes are for
+# the host ABI: pointers (pb_callback_t) are 8 bytes here but 4 on the ESP32,
+# so callback fields come out slightly smaller on target.
+SIZE_TYPES=(
+    meshtastic_FromRadio
+    meshtastic_ToRadio
+    meshtastic_MeshPacket
+    meshtastic_Data
+    meshtastic_MyNodeInfo
+    meshtastic_NodeInfo
+    meshtastic_User
+    meshtastic_Position
+    meshtastic_NeighborInfo
+    meshtastic_RouteDiscovery
+    meshtastic_LogRecord
+    meshtastic_Telemetry
+)
+
+# measure <proto dir> <output file>
+measure() {
+    local dir="$1" out="$2" prog="$OPTIONS_TMP/sizes"
+    {
+        echo '#include <stdio.h>'
+        echo '#include "meshtastic/mesh.pb.h"'
+        echo '#include "meshtastic/telemetry.pb.h"'
+        echo 'int main(void) {'
+        for t in "${SIZE_TYPES[@]}"; do
+            echo "    printf(\"%s %zu\\n\", \"$t\", sizeof($t));"
+        done
+        echo '    return 0;'
+        echo '}'
+    } > "$prog.c"
+    "${CC:-cc}" -I"$NANOPB_DIR" -I"$dir" "$prog.c" -o "$prog" && "$prog" > "$out"
+}
+
+SIZES_FILE="$PROTO_OUT_DIR/SIZES.txt"
+if ! command -v "${CC:-cc}" > /dev/null; then
+    echo "  WARN: no host C compiler (\$CC / cc) — skipping size report"
+elif [[ -z "$PROTO_PROFILE" ]]; then
+    echo "  (no profile — skipping size report)"
+else
+    echo "==> Measuring struct sizes (upstream options vs. profile)..."
+    generate "$OPTIONS_TMP/baseline" "" > /dev/null
+    if measure "$OPTIONS_TMP/baseline" "$OPTIONS_TMP/before.txt" &&
+       measure "$PROTO_OUT_DIR" "$OPTIONS_TMP/after.txt"; then
+        {
+            echo "# sizeof() of decoded nanopb types, host ABI."
+            echo "# Meshtastic protobufs ${MESHTASTIC_PROTO_VERSION}, nanopb ${NANOPB_VERSION}."
+            echo "# before = upstream .options only, after = + $(basename "$PROTO_PROFILE")"
+            echo "# Regenerated by scripts/gen_proto.sh — do not edit."
+            echo ""
+            printf "%-28s %8s %8s %8s\n" type before after saved
+            paste -d ' ' "$OPTIONS_TMP/before.txt" "$OPTIONS_TMP/after.txt" |
+                awk '{ printf "%-28s %8d %8d %8d\n", $1, $2, $4, $2 - $4 }'
+        } > "$SIZES_FILE"
+        cat "$SIZES_FILE"
+    else
+        echo "  WARN: size report build failed — SIZES.txt not updated"
     fi
-    echo "  generating ${proto}.pb.{h,c}"
-    python3 "$NANOPB_GENERATOR" \
-        --proto-path="$PROTO_SRC_DIR" \
-        --output-dir="$PROTO_OUT_DIR" \
-        "$src"
-done
+fi
 
 # ── Cleanup ───────────────────────────────────────────────────────────────────
-rm -rf "$TMP_NANOPB" "$PROTO_SRC_DIR"
+rm -rf "$TMP_NANOPB" "$PROTO_SRC_DIR" "$OPTIONS_TMP"
 
 echo ""
 echo "Done.  Generated files are in:"
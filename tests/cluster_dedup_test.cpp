@@ -0,0 +1,351 @@
+// Host test for cluster_dedup.h: digest encoding, ownership ranking, and a
+// three-gateway simulation over an in-memory broker.
+//
+// Each simulated gateway drives a ClusterFilter the way
+// MeshtasticBLEComponent::cluster_claim_() / release_held_() /
+// publish_digest_() do, with the same hold pool size.  The broker delivers
+// every digest to every gateway (the sender included) after a fixed latency.
+// Each packet is heard by a random, non-empty subset of gateways at slightly
+// different times.  The test counts how often each packet was forwarded.
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "cluster_dedup.h"
+
+using namespace esphome::meshtastic_ble;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);    \
+            failures++;                                               \
+        }                                                             \
+    } while (0)
+
+// Same key derivation as packet_key() in meshtastic_ble.cpp.
+uint32_t packet_key(uint32_t from, uint32_t id) {
+    const uint32_t ids[2] = {from, id};
+    const auto *p = reinterpret_cast<const uint8_t *>(ids);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(ids); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h != 0 ? h : 1;
+}
+
+// Deterministic xorshift so every run sees the same traffic.
+struct Rng {
+    uint32_t s;
+    uint32_t next() {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+// ── Unit checks ───────────────────────────────────────────────────────────────
+
+void test_digest_round_trip() {
+    ClusterFilter a, b;
+    a.set_gateway_id(0x1111);
+    b.set_gateway_id(0x2222);
+
+    for (uint32_t id = 1; id <= 5; id++) a.forwarded(packet_key(7, id));
+    CHECK(a.pending() == 5);
+    uint8_t buf[ClusterFilter::DIGEST_MAX_BYTES];
+    const size_t len = a.write_digest(buf, 100);
+    CHECK(len == CLUSTER_DIGEST_HEADER_LEN + 5 * 4);
+
+    uint32_t sender = 0;
+    CHECK(a.on_digest(buf, len, 100) == DigestResult::OWN);
+    CHECK(b.on_digest(buf, len, 100, &sender) == DigestResult::PEER_JOINED);
+    CHECK(sender == 0x1111);
+    CHECK(b.on_digest(buf, len, 200) == DigestResult::ACCEPTED);
+    for (uint32_t id = 1; id <= 5; id++) CHECK(b.reported(packet_key(7, id)));
+    CHECK(!b.reported(packet_key(7, 6)));
+    CHECK(!a.reported(packet_key(7, 1)));  // own keys never enter the filter
+
+    // Truncated, wrong magic / version, and a zero sender are ignored.
+    CHECK(b.on_digest(buf, len - 1, 300) == DigestResult::IGNORED);
+    CHECK(b.on_digest(buf, CLUSTER_DIGEST_HEADER_LEN - 1, 300) == DigestResult::IGNORED);
+    uint8_t bad[ClusterFilter::DIGEST_MAX_BYTES];
+    memcpy(bad, buf, len);
+    bad[2] = CLUSTER_DIGEST_VERSION + 1;
+    CHECK(b.on_digest(bad, len, 300) == DigestResult::IGNORED);
+    memcpy(bad, buf, len);
+    memset(bad + 4, 0, 4);
+    CHECK(b.on_digest(bad, len, 300) == DigestResult::IGNORED);
+
+    a.digest_sent();
+    CHECK(a.pending() == 0);
+    for (uint32_t i = 0; i < CLUSTER_DIGEST_MAX_KEYS + 10; i++) a.forwarded(i);
+    CHECK(a.digest_due(101, 1000));  // full: due at once
+    CHECK(a.pending() == CLUSTER_DIGEST_MAX_KEYS);
+}
+
+void test_digest_schedule() {
+    const uint32_t interval = 1000;
+    ClusterFilter f;
+    f.set_gateway_id(0x1111);
+    uint8_t buf[ClusterFilter::DIGEST_MAX_BYTES];
+
+    // Announced at start, and retried every interval until one is published.
+    CHECK(f.digest_due(5, interval));
+    f.write_digest(buf, 5);
+    CHECK(!f.digest_due(5 + interval - 1, interval));
+    CHECK(f.digest_due(5 + interval, interval));
+    f.write_digest(buf, 5 + interval);
+    f.digest_sent();
+
+    // Idle: only a heartbeat, CLUSTER_HEARTBEAT_MS after the last one.
+    const uint32_t t0 = 5 + interval;
+    CHECK(!f.digest_due(t0 + interval, interval));
+    CHECK(!f.digest_due(t0 + CLUSTER_HEARTBEAT_MS - 1, interval));
+    CHECK(f.digest_due(t0 + CLUSTER_HEARTBEAT_MS, interval));
+    CHECK(f.write_digest(buf, t0 + CLUSTER_HEARTBEAT_MS) == CLUSTER_DIGEST_HEADER_LEN);
+    f.digest_sent();
+
+    // Keys go out after interval_ms.
+    const uint32_t t1 = t0 + CLUSTER_HEARTBEAT_MS;
+    f.forwarded(42);
+    CHECK(!f.digest_due(t1 + interval - 1, interval));
+    CHECK(f.digest_due(t1 + interval, interval));
+}
+
+void test_rank_is_a_permutation() {
+    const uint32_t ids[3] = {0xE835BD5E, 0x03D252AA, 0x7F00F00D};
+    ClusterFilter f[3];
+    for (int i = 0; i < 3; i++) f[i].set_gateway_id(ids[i]);
+    // Introduce everyone with an empty digest.
+    for (int i = 0; i < 3; i++) {
+        uint8_t buf[ClusterFilter::DIGEST_MAX_BYTES];
+        const size_t len = f[i].write_digest(buf, 0);
+        for (int j = 0; j < 3; j++) f[j].on_digest(buf, len, 0);
+    }
+
+    int owned[3] = {0, 0, 0};
+    for (uint32_t id = 0; id < 3000; id++) {
+        const uint32_t key = packet_key(42, id);
+        int seen = 0;
+        for (int i = 0; i < 3; i++) {
+            const uint8_t r = f[i].rank(key, 1000);
+            CHECK(r < 3);
+            seen |= 1 << r;
+            if (r == 0) owned[i]++;
+        }
+        if (seen != 0b111) {
+            printf("FAIL key %08X: ranks are not 0, 1, 2\n", key);
+            failures++;
+            break;
+        }
+    }
+    // Ownership is spread evenly (expected 1000 each).
+    for (int i = 0; i < 3; i++) CHECK(owned[i] > 850 && owned[i] < 1150);
+
+    // A peer silent for CLUSTER_PEER_TTL_MS drops out of the ranking.
+    for (uint32_t id = 0; id < 100; id++) CHECK(f[0].rank(packet_key(42, id), CLUSTER_PEER_TTL_MS + 1) == 0);
+}
+
+// ── Simulation ────────────────────────────────────────────────────────────────
+
+constexpr int GATEWAYS = 3;
+constexpr size_t HOLD_SLOTS = 16;  // MeshtasticBLEComponent::CLUSTER_HOLD_SLOTS
+constexpr uint32_t FROM = 0x0000BEEF;
+
+// Local stand-in for the MQTT broker: QoS 0 fan-out, fixed latency.
+struct Broker {
+    struct Message {
+        uint32_t deliver_at;
+        std::vector<uint8_t> payload;
+    };
+    uint32_t latency_ms;
+    std::deque<Message> queue;
+
+    void publish(uint32_t now, const uint8_t *data, size_t len) {
+        queue.push_back({now + latency_ms, std::vector<uint8_t>(data, data + len)});
+    }
+};
+
+struct Held {
+    uint32_t key;
+    uint32_t id;
+    uint32_t deadline_ms;
+};
+
+struct Gateway {
+    ClusterFilter filter;
+    bool tie_break;
+    uint32_t hold_ms;
+    uint32_t digest_interval_ms;
+    uint32_t digests{0};
+    std::vector<Held> held;
+    uint32_t suppressed{0};
+    std::vector<int> *forwards;
+
+    void forward(uint32_t id, uint32_t key) {
+        filter.forwarded(key);
+        (*forwards)[id]++;
+    }
+
+    // cluster_claim_()
+    void on_packet(uint32_t now, uint32_t id) {
+        const uint32_t key = packet_key(FROM, id);
+        if (filter.reported(key)) {
+            suppressed++;
+            return;
+        }
+        const uint8_t rank = tie_break ? filter.rank(key, now) : 0;
+        if (rank != 0 && held.size() < HOLD_SLOTS) {
+            held.push_back({key, id, now + rank * hold_ms});
+            return;
+        }
+        forward(id, key);
+    }
+
+    // release_held_() and the digest timer in loop()
+    void loop(uint32_t now, Broker &broker) {
+        filter.tick(now);
+        for (size_t i = 0; i < held.size();) {
+            const Held h = held[i];
+            if (filter.reported(h.key)) {
+                suppressed++;
+            } else if ((int32_t) (now - h.deadline_ms) >= 0) {
+                forward(h.id, h.key);
+            } else {
+                i++;
+                continue;
+            }
+            held.erase(held.begin() + i);
+        }
+        if (filter.digest_due(now, digest_interval_ms)) {
+            uint8_t buf[ClusterFilter::DIGEST_MAX_BYTES];
+            broker.publish(now, buf, filter.write_digest(buf, now));
+            filter.digest_sent();
+            digests++;
+        }
+    }
+};
+
+struct SimResult {
+    uint32_t packets;
+    uint32_t lost;        // heard by some gateway, forwarded by none
+    uint32_t duplicates;  // extra forwards beyond the first
+    uint32_t digests;     // published by all gateways, heartbeats included
+};
+
+SimResult simulate(bool tie_break, uint32_t packets, uint32_t packet_interval_ms) {
+    const uint32_t gw_ids[GATEWAYS] = {0xE835BD5E, 0x03D252AA, 0x7F00F00D};
+    const uint32_t step_ms = 10;
+    const uint32_t max_jitter_ms = 300;  // spread between gateways hearing the same packet
+
+    std::vector<int> forwards(packets, 0);
+    Broker broker{50, {}};
+    Gateway gw[GATEWAYS];
+    for (int i = 0; i < GATEWAYS; i++) {
+        gw[i].filter.set_gateway_id(gw_ids[i]);
+        gw[i].tie_break = tie_break;
+        gw[i].hold_ms = 1500;
+        gw[i].digest_interval_ms = 1000;
+        gw[i].forwards = &forwards;
+    }
+
+    // Reception schedule: arrival[p][g] = time gateway g hears packet p, or 0.
+    Rng rng{0x12345678};
+    const uint32_t start_ms = 5000;
+    std::vector<uint32_t> arrival(packets * GATEWAYS, 0);
+    for (uint32_t p = 0; p < packets; p++) {
+        int mask;
+        do {
+            mask = 0;
+            for (int g = 0; g < GATEWAYS; g++) {
+                if (rng.below(100) < 70) mask |= 1 << g;
+            }
+        } while (mask == 0);
+        for (int g = 0; g < GATEWAYS; g++) {
+            if (mask & (1 << g)) arrival[p * GATEWAYS + g] = start_ms + p * packet_interval_ms + rng.below(max_jitter_ms);
+        }
+    }
+
+    const uint32_t end_ms = start_ms + packets * packet_interval_ms + max_jitter_ms + 10000;
+    for (uint32_t now = step_ms; now < end_ms; now += step_ms) {
+        const uint32_t first = now > start_ms + max_jitter_ms ? (now - start_ms - max_jitter_ms) / packet_interval_ms : 0;
+        for (uint32_t p = first; p < packets && start_ms + p * packet_interval_ms <= now; p++) {
+            for (int g = 0; g < GATEWAYS; g++) {
+                const uint32_t at = arrival[p * GATEWAYS + g];
+                if (at != 0 && at > now - step_ms && at <= now) gw[g].on_packet(now, p);
+            }
+        }
+        for (auto &g : gw) g.loop(now, broker);
+        while (!broker.queue.empty() && broker.queue.front().deliver_at <= now) {
+            const Broker::Message msg = broker.queue.front();
+            broker.queue.pop_front();
+            for (auto &g : gw) g.filter.on_digest(msg.payload.data(), msg.payload.size(), now);
+        }
+    }
+
+    SimResult r{packets, 0, 0, 0};
+    for (const auto &g : gw) r.digests += g.digests;
+    for (uint32_t p = 0; p < packets; p++) {
+        if (forwards[p] == 0) r.lost++;
+        if (forwards[p] > 1) r.duplicates += forwards[p] - 1;
+    }
+    return r;
+}
+
+void test_simulation() {
+    // ~12.5 minutes of traffic at 4 packets/s: several Bloom rotations, both
+    // by capacity and by CLUSTER_BLOOM_ROTATE_MS.
+    const uint32_t packets = 3000;
+    const SimResult with = simulate(true, packets, 250);
+    const SimResult without = simulate(false, packets, 250);
+    printf("tie_break on : %u packets, %u lost, %u duplicates\n", with.packets, with.lost, with.duplicates);
+    printf("tie_break off: %u packets, %u lost, %u duplicates\n", without.packets, without.lost,
+           without.duplicates);
+
+    // Losses only come from Bloom false positives (documented ~2% at full
+    // fill); duplicates only from a digest arriving after a hold expired.
+    CHECK(with.lost * 100 <= with.packets * 2);
+    CHECK(with.duplicates * 100 <= with.packets * 1);
+    CHECK(without.lost * 100 <= without.packets * 2);
+    // Without ranking, every gateway that hears a packet before a peer's
+    // digest arrives forwards it.
+    CHECK(without.duplicates > with.duplicates * 10);
+}
+
+void test_low_traffic() {
+    // One packet every 90 s, longer than CLUSTER_PEER_TTL_MS: peers only stay
+    // in each other's ranking through heartbeat digests.
+    const uint32_t interval_ms = CLUSTER_PEER_TTL_MS * 3 / 2;
+    const SimResult r = simulate(true, 40, interval_ms);
+    printf("low traffic  : %u packets, %u lost, %u duplicates, %u digests\n", r.packets, r.lost,
+           r.duplicates, r.digests);
+    CHECK(r.lost == 0);
+    CHECK(r.duplicates == 0);
+}
+
+}  // namespace
+
+int main() {
+    test_digest_round_trip();
+    test_digest_schedule();
+    test_rank_is_a_permutation();
+    test_simulation();
+    test_low_traffic();
+
+    if (failures != 0) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Host-test stand-in for the defines.h ESPHome generates at build time.  The
+// tests define whatever the header under test reads (e.g.
+// MESHTASTIC_TOPIC_SCHEMA) themselves, before including it.
@@ -0,0 +1,135 @@
+// Host test for topic_schema.h: rendered topics for each supported layout,
+// truncation, and agreement with the snprintf it replaced.  The timing of both
+// is printed for reference only; it never fails the test.
+//
+// Built once per layout (see CMakeLists.txt); TOPIC_LAYOUT selects the schema
+// the same way __init__.py would emit it into defines.h.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#define TOPIC_LAYOUT_DEFAULT 0  // {node}/{suffix}
+#define TOPIC_LAYOUT_LOWER 1    // !{node_lower}/{suffix}
+#define TOPIC_LAYOUT_CHANNEL 2  // ch{channel}/{node_dec}/{suffix}
+
+#ifndef TOPIC_LAYOUT
+#define TOPIC_LAYOUT TOPIC_LAYOUT_DEFAULT
+#endif
+
+#if TOPIC_LAYOUT == TOPIC_LAYOUT_LOWER
+#define MESHTASTIC_TOPIC_SCHEMA \
+    { {TopicPart::LITERAL, "!", 1}, {TopicPart::NODE_HEX_LOWER, "", 0}, {TopicPart::LITERAL, "/", 1}, \
+      {TopicPart::SUFFIX, "", 0} }
+#elif TOPIC_LAYOUT == TOPIC_LAYOUT_CHANNEL
+#define MESHTASTIC_TOPIC_SCHEMA \
+    { {TopicPart::LITERAL, "ch", 2}, {TopicPart::CHANNEL, "", 0}, {TopicPart::LITERAL, "/", 1}, \
+      {TopicPart::NODE_DEC, "", 0}, {TopicPart::LITERAL, "/", 1}, {TopicPart::SUFFIX, "", 0} }
+#endif
+
+#include "topic_schema.h"
+
+using namespace esphome::meshtastic_ble;
+
+namespace {
+
+int failures = 0;
+
+void expect_topic(uint32_t node, uint8_t channel, const char *suffix, size_t size, const char *want) {
+    char buf[128];  // room for a guard byte past `size`
+    memset(buf, 0x55, sizeof(buf));
+    const size_t n = format_topic(buf, size, node, channel, suffix);
+    if (n != strlen(want) || strcmp(buf, want) != 0) {
+        printf("FAIL format_topic(%08X, %u, \"%s\", %zu): got \"%s\" (%zu), want \"%s\"\n", node, channel,
+               suffix, size, buf, n, want);
+        failures++;
+    }
+    if (buf[size] != 0x55) {
+        printf("FAIL format_topic(..., %zu) wrote past the buffer\n", size);
+        failures++;
+    }
+}
+
+// The snprintf call each layout replaced, for the timing comparison.
+int reference_topic(char *buf, size_t size, uint32_t node, uint8_t channel, const char *suffix) {
+#if TOPIC_LAYOUT == TOPIC_LAYOUT_LOWER
+    (void) channel;
+    return snprintf(buf, size, "!%08x/%s", node, suffix);
+#elif TOPIC_LAYOUT == TOPIC_LAYOUT_CHANNEL
+    return snprintf(buf, size, "ch%u/%u/%s", channel, node, suffix);
+#else
+    (void) channel;
+    return snprintf(buf, size, "%08X/%s", node, suffix);
+#endif
+}
+
+template<typename F> double ns_per_call(F &&fn, uint32_t iterations) {
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) fn(i);
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+}
+
+}  // namespace
+
+int main() {
+    const char *suffix = "telemetry/voltage";
+
+#if TOPIC_LAYOUT == TOPIC_LAYOUT_LOWER
+    static_assert(!topic_schema_uses(TopicPart::CHANNEL), "layout has no {channel}");
+    expect_topic(0xA1B2C3D4, 3, suffix, 96, "!a1b2c3d4/telemetry/voltage");
+    expect_topic(0x0000000F, 0, "text", 96, "!0000000f/text");
+    expect_topic(0xA1B2C3D4, 3, suffix, 8, "!a1b2c3");
+#elif TOPIC_LAYOUT == TOPIC_LAYOUT_CHANNEL
+    static_assert(topic_schema_uses(TopicPart::CHANNEL), "layout has {channel}");
+    expect_topic(0xA1B2C3D4, 3, suffix, 96, "ch3/2712847316/telemetry/voltage");
+    expect_topic(0, 7, "text", 96, "ch7/0/text");
+    expect_topic(0xA1B2C3D4, 12, suffix, 96, "ch12/2712847316/telemetry/voltage");
+    expect_topic(0xA1B2C3D4, 3, suffix, 8, "ch3/271");
+#else
+    static_assert(!topic_schema_uses(TopicPart::CHANNEL), "layout has no {channel}");
+    expect_topic(0xA1B2C3D4, 3, suffix, 96, "A1B2C3D4/telemetry/voltage");
+    expect_topic(0x0000000F, 0, "text", 96, "0000000F/text");
+    expect_topic(0xA1B2C3D4, 3, suffix, 8, "A1B2C3D");
+    expect_topic(0xA1B2C3D4, 3, suffix, 10, "A1B2C3D4/");
+#endif
+    // Degenerate sizes: only the NUL fits, or nothing at all.
+    expect_topic(0xA1B2C3D4, 3, suffix, 1, "");
+    {
+        char guard = 0x55;
+        if (format_topic(&guard, 0, 0xA1B2C3D4, 3, suffix) != 0 || guard != 0x55) {
+            printf("FAIL format_topic() with size 0 wrote to the buffer\n");
+            failures++;
+        }
+    }
+
+    // Same inputs through both formatters must agree before timing them.
+    char a[96], b[96];
+    for (uint32_t i = 0; i < 1000; i++) {
+        const uint32_t node = i * 2654435761u;
+        const uint8_t channel = i & 7;
+        format_topic(a, sizeof(a), node, channel, suffix);
+        reference_topic(b, sizeof(b), node, channel, suffix);
+        if (strcmp(a, b) != 0) {
+            printf("FAIL node %08X: format_topic \"%s\" != snprintf \"%s\"\n", node, a, b);
+            failures++;
+            break;
+        }
+    }
+
+    const uint32_t iterations = 2000000;
+    volatile size_t sink = 0;
+    const double schema_ns = ns_per_call(
+        [&](uint32_t i) { sink = sink + format_topic(a, sizeof(a), i * 2654435761u, i & 7, suffix); }, iterations);
+    const double snprintf_ns = ns_per_call(
+        [&](uint32_t i) { sink = sink + reference_topic(b, sizeof(b), i * 2654435761u, i & 7, suffix); }, iterations);
+    printf("format_topic %.1f ns/call, snprintf %.1f ns/call (%.1fx)\n", schema_ns, snprintf_ns,
+           snprintf_ns / schema_ns);
+
+    if (failures != 0) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}